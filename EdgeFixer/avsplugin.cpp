@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <vector>
 #include <avisynth.h>
 
 extern "C" {
@@ -7,22 +12,139 @@ extern "C" {
 
 const AVS_Linkage *AVS_linkage;
 
-class ContinuityFixer: public GenericVideoFilter {
-	int m_left;
-	int m_top;
-	int m_right;
-	int m_bottom;
-	int m_radius;
-	int m_cleft;
-	int m_ctop;
-	int m_cright;
-	int m_cbottom;
+struct EdgeFixerParams {
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int radius;
+	int cleft;
+	int ctop;
+	int cright;
+	int cbottom;
+	int first;
+	int last;
+	bool passthrough;
+	bool measure;
+	bool fields;
+	int cropleft;
+	int croptop;
+	int cropright;
+	int cropbottom;
+	int sample;
+	int activex;
+	int activey;
+	int activewidth;
+	int activeheight;
+	int detect;
+	const char *zones;
+	bool frameprops;
+};
+
+// Edges and radius for the frames first to last.
+struct EdgeFixerZone {
+	int first;
+	int last;
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int radius;
+};
+
+// Region of the output whose edges are fixed, in luma samples or, through
+// PlaneRegion, in the samples of one plane.
+struct ActiveRegion {
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+// Reads every integer in text, skipping separators such as spaces, commas
+// and semicolons.
+static std::vector<int> ParseInts(const char *text)
+{
+	std::vector<int> values;
+	while (*text)
+	{
+		char *end;
+		long value = strtol(text, &end, 10);
+		if (end == text)
+		{
+			++text;
+			continue;
+		}
+		values.push_back((int)value);
+		text = end;
+	}
+	return values;
+}
+
+// Parses a zone list: groups of first, last, left, top, right, bottom and
+// radius. Returns false if the number of values is not a multiple of 7.
+static bool ParseZones(const char *text, std::vector<EdgeFixerZone>& zones)
+{
+	std::vector<int> values = ParseInts(text);
+	if (values.size() % 7)
+		return false;
+
+	for (size_t i = 0; i < values.size(); i += 7)
+	{
+		EdgeFixerZone zone = { values[i], values[i + 1], values[i + 2], values[i + 3], values[i + 4], values[i + 5], values[i + 6] };
+		zones.push_back(zone);
+	}
+	return true;
+}
+
+// Reads the arguments shared by both filters, starting at args[index].
+static EdgeFixerParams ReadParams(const AVSValue& args, int index)
+{
+	EdgeFixerParams p;
+	p.left = args[index + 0].AsInt(0);
+	p.top = args[index + 1].AsInt(0);
+	p.right = args[index + 2].AsInt(0);
+	p.bottom = args[index + 3].AsInt(0);
+	p.radius = args[index + 4].AsInt(0);
+	p.cleft = args[index + 5].AsInt(0);
+	p.ctop = args[index + 6].AsInt(0);
+	p.cright = args[index + 7].AsInt(0);
+	p.cbottom = args[index + 8].AsInt(0);
+	p.first = args[index + 9].AsInt(0);
+	p.last = args[index + 10].AsInt(INT_MAX);
+	p.passthrough = args[index + 11].AsBool(false);
+	p.measure = args[index + 12].AsBool(false);
+	p.fields = args[index + 13].AsBool(false);
+	p.cropleft = args[index + 14].AsInt(0);
+	p.croptop = args[index + 15].AsInt(0);
+	p.cropright = args[index + 16].AsInt(0);
+	p.cropbottom = args[index + 17].AsInt(0);
+	p.sample = args[index + 18].AsInt(1);
+	p.activex = args[index + 19].AsInt(0);
+	p.activey = args[index + 20].AsInt(0);
+	p.activewidth = args[index + 21].AsInt(0);
+	p.activeheight = args[index + 22].AsInt(0);
+	p.detect = args[index + 23].AsInt(-1);
+	p.zones = args[index + 24].AsString("");
+	p.frameprops = args[index + 25].AsBool(false);
+	return p;
+}
+
+class EdgeFixerBase: public GenericVideoFilter {
+protected:
+	EdgeFixerParams m_params;
 	int m_planes;
-public:
-	ContinuityFixer(PClip _child, int left, int top, int right, int bottom, int radius, int cleft, int ctop, int cright, int cbottom)
-		: GenericVideoFilter(_child), m_left(left), m_top(top), m_right(right), m_bottom(bottom), m_radius(radius), m_cleft(cleft), m_ctop(ctop), m_cright(cright), m_cbottom(cbottom)
+	int m_fields;
+	int m_ref_scale_x;
+	int m_ref_scale_y;
+	ActiveRegion m_active;
+	std::vector<EdgeFixerZone> m_zones;
+	const char *m_name;
+
+	EdgeFixerBase(PClip _child, const EdgeFixerParams& params, const char *name, IScriptEnvironment *env)
+		: GenericVideoFilter(_child), m_params(params), m_fields(params.fields ? 2 : 1), m_ref_scale_x(1), m_ref_scale_y(1), m_name(name)
 	{
-		if (cleft | ctop | cright | cbottom)
+		if (params.cleft | params.ctop | params.cright | params.cbottom)
 		{
 			m_planes = PLANAR_Y | PLANAR_U | PLANAR_V;
 		}
@@ -34,133 +156,388 @@ public:
 		{
 			m_planes = PLANAR_R | PLANAR_G | PLANAR_B;
 		}
-	}
 
-	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env)
-	{
-		PVideoFrame frame = child->GetFrame(n, env);
-		env->MakeWritable(&frame);
+		vi.width -= params.cropleft + params.cropright;
+		vi.height -= params.croptop + params.cropbottom;
 
-		int step = vi.ComponentSize();
-		size_t (*required_buffer)(int) = step == 2 ? edgefixer_required_buffer_w : edgefixer_required_buffer_b;
+		m_active.x = params.activex;
+		m_active.y = params.activey;
+		m_active.width = params.activewidth ? params.activewidth : vi.width - params.activex;
+		m_active.height = params.activeheight ? params.activeheight : vi.height - params.activey;
 
-		void *tmp = malloc(required_buffer(vi.width > vi.height ? vi.width : vi.height));
-		if (!tmp)
-			env->ThrowError("[ContinuityFixer] error allocating temporary buffer");
-
-		int planes_todo = m_planes;
-		while (planes_todo)
+		// The arguments and zones are checked here; frame properties are checked per frame.
+		if (const char *error = CheckEdges(params))
+			env->ThrowError("[%s] %s", m_name, error);
+		ParseZones(params.zones, m_zones);
+		for (size_t i = 0; i < m_zones.size(); ++i)
 		{
-			int plane = planes_todo & -planes_todo; // extract lowest bit
-			ProcessPlane(plane, frame, step, tmp);
-			planes_todo &= ~plane;
+			EdgeFixerParams p = params;
+			ApplyZone(p, m_zones[i]);
+			if (const char *error = CheckEdges(p))
+				env->ThrowError("[%s] zone %d: %s", m_name, (int)i, error);
 		}
+	}
 
-		free(tmp);
-
-		return frame;
+	bool Cropping() const
+	{
+		return !!(m_params.cropleft | m_params.croptop | m_params.cropright | m_params.cropbottom);
 	}
-private:
-	void ProcessPlane(int plane, PVideoFrame& frame, int step, void *tmp)
+
+	// Returns a view of the output region of a source frame, or of a
+	// reference frame scaled down by scale_x and scale_y. Nothing is copied
+	// here; MakeWritable later copies only this region.
+	PVideoFrame Crop(const PVideoFrame& frame, IScriptEnvironment *env, int scale_x = 1, int scale_y = 1) const
 	{
-		int width = frame->GetRowSize(plane) / step;
-		int height = frame->GetHeight(plane);
-		int stride = frame->GetPitch(plane);
+		const VideoInfo& src_vi = child->GetVideoInfo();
+		int size = src_vi.ComponentSize();
+		int crop_left = m_params.cropleft / scale_x;
+		int crop_top = m_params.croptop / scale_y;
+		int width = vi.width / scale_x;
+		int height = vi.height / scale_y;
+		int pitch = frame->GetPitch(PLANAR_Y);
+		int offset = crop_top * pitch + crop_left * size;
+
+		if (src_vi.NumComponents() == 1)
+			return env->Subframe(frame, offset, pitch, width * size, height);
+
+		int ssw = src_vi.IsRGB() ? 0 : src_vi.GetPlaneWidthSubsampling(PLANAR_U);
+		int ssh = src_vi.IsRGB() ? 0 : src_vi.GetPlaneHeightSubsampling(PLANAR_U);
+		int pitch_uv = frame->GetPitch(PLANAR_U);
+		int offset_uv = (crop_top >> ssh) * pitch_uv + (crop_left >> ssw) * size;
+
+		if (src_vi.NumComponents() == 4)
+			return env->SubframePlanarA(frame, offset, pitch, width * size, height, offset_uv, offset_uv, pitch_uv, offset);
+		return env->SubframePlanar(frame, offset, pitch, width * size, height, offset_uv, offset_uv, pitch_uv);
+	}
 
-		void (*process_edge)(void *, const void *, int, int, int, int, void *) = step == 2 ? edgefixer_process_edge_w : edgefixer_process_edge_b;
+	bool RefScaled() const
+	{
+		return m_ref_scale_x > 1 || m_ref_scale_y > 1;
+	}
 
-		BYTE *ptr = frame->GetWritePtr(plane);
+	// The region of a scaled-down reference matching a plane region.
+	ActiveRegion RefRegion(const ActiveRegion& r) const
+	{
+		ActiveRegion rr = { r.x / m_ref_scale_x, r.y / m_ref_scale_y, r.width / m_ref_scale_x, r.height / m_ref_scale_y };
+		return rr;
+	}
 
-		int left, top, right, bottom;
+	static void GetEdges(const EdgeFixerParams& p, int plane, int& left, int& top, int& right, int& bottom)
+	{
 		if (plane == PLANAR_U || plane == PLANAR_V)
 		{
-			left = m_cleft;
-			top = m_ctop;
-			right = m_cright;
-			bottom = m_cbottom;
+			left = p.cleft;
+			top = p.ctop;
+			right = p.cright;
+			bottom = p.cbottom;
 		}
 		else
 		{
-			left = m_left;
-			top = m_top;
-			right = m_right;
-			bottom = m_bottom;
+			left = p.left;
+			top = p.top;
+			right = p.right;
+			bottom = p.bottom;
 		}
+	}
+
+	static void GetProp(const AVSMap *props, const char *key, int& value, IScriptEnvironment *env)
+	{
+		int err;
+		int prop = (int)env->propGetInt(props, key, 0, &err);
+		if (!err)
+			value = prop;
+	}
 
-		// top
-		for (int i = 0; i < top; ++i) {
-			int ref_row = top - i;
-			process_edge(ptr + stride * (ref_row - 1), ptr + stride * ref_row, step, step, width, m_radius, tmp);
+	static void ApplyZone(EdgeFixerParams& p, const EdgeFixerZone& zone)
+	{
+		p.left = zone.left;
+		p.top = zone.top;
+		p.right = zone.right;
+		p.bottom = zone.bottom;
+		p.radius = zone.radius;
+	}
+
+	// Returns the parameters for frame n: the luma edges and radius of the
+	// first zone holding n, then any the frame carries as properties.
+	EdgeFixerParams FrameParams(int n, const PVideoFrame& frame, IScriptEnvironment *env) const
+	{
+		EdgeFixerParams p = m_params;
+
+		for (size_t i = 0; i < m_zones.size(); ++i)
+		{
+			if (n >= m_zones[i].first && n <= m_zones[i].last)
+			{
+				ApplyZone(p, m_zones[i]);
+				break;
+			}
 		}
 
-		// bottom
-		for (int i = 0; i < bottom; ++i) {
-			int ref_row = height - bottom - 1 + i;
-			process_edge(ptr + stride * (ref_row + 1), ptr + stride * ref_row, step, step, width, m_radius, tmp);
+		if (p.frameprops)
+		{
+			const AVSMap *props = env->getFramePropsRO(frame);
+			GetProp(props, "EdgeFixerLeft", p.left, env);
+			GetProp(props, "EdgeFixerTop", p.top, env);
+			GetProp(props, "EdgeFixerRight", p.right, env);
+			GetProp(props, "EdgeFixerBottom", p.bottom, env);
+			GetProp(props, "EdgeFixerRadius", p.radius, env);
 		}
 
-		// left
-		for (int i = 0; i < left; ++i) {
-			int ref_col = left - i;
-			process_edge(ptr + step * (ref_col - 1), ptr + step * ref_col, stride, stride, height, m_radius, tmp);
+		if (const char *error = CheckEdges(p))
+			env->ThrowError("[%s] frame %d: %s", m_name, n, error);
+		return p;
+	}
+
+	// Returns an error message if the edges and radius of p are unusable, or
+	// 0 if they are.
+	const char *CheckEdges(const EdgeFixerParams& p) const
+	{
+		if (p.left < 0 || p.top < 0 || p.right < 0 || p.bottom < 0)
+			return "too few edges to fix";
+		if (!EdgesFit(p, m_active))
+			return "too many edges to fix";
+		if (p.sample > 1 && p.radius)
+			return "sample requires radius 0";
+		return 0;
+	}
+
+	bool EdgesFit(const EdgeFixerParams& p, const ActiveRegion& active) const
+	{
+		int planes_todo = m_planes;
+		while (planes_todo)
+		{
+			int plane = planes_todo & -planes_todo; // extract lowest bit
+			planes_todo &= ~plane;
+
+			ActiveRegion r = PlaneRegion(plane, active);
+			int left, top, right, bottom;
+			GetEdges(p, plane, left, top, right, bottom);
+			if (std::max(left, right) > r.width || std::max(top, bottom) > r.height / m_fields)
+				return false;
 		}
+		return true;
+	}
+
+	static bool HasEdges(const EdgeFixerParams& p)
+	{
+		return !!(p.left | p.top | p.right | p.bottom | p.cleft | p.ctop | p.cright | p.cbottom);
+	}
 
-		// right
-		for (int i = 0; i < right; ++i) {
-			int ref_col = width - right - 1 + i;
-			process_edge(ptr + step * (ref_col + 1), ptr + step * ref_col, stride, stride, height, m_radius, tmp);
+	int SubsamplingW(int plane) const
+	{
+		return plane == PLANAR_U || plane == PLANAR_V ? vi.GetPlaneWidthSubsampling(plane) : 0;
+	}
+
+	int SubsamplingH(int plane) const
+	{
+		return plane == PLANAR_U || plane == PLANAR_V ? vi.GetPlaneHeightSubsampling(plane) : 0;
+	}
+
+	ActiveRegion PlaneRegion(int plane, const ActiveRegion& active) const
+	{
+		int ssw = SubsamplingW(plane);
+		int ssh = SubsamplingH(plane);
+		ActiveRegion r = { active.x >> ssw, active.y >> ssh, active.width >> ssw, active.height >> ssh };
+		return r;
+	}
+
+	// Byte offset of the active region within a plane.
+	int RegionOffset(const ActiveRegion& r, int pitch) const
+	{
+		return r.y * pitch + r.x * vi.ComponentSize();
+	}
+
+	// Narrows active to the picture inside the black bars of the luma or RGB
+	// planes, rounded outwards so that every processed plane and field starts
+	// on a whole line, also of a scaled reference. Returns false if no picture is found or it is too small
+	// for the edge counts.
+	bool Detect(const EdgeFixerParams& p, const PVideoFrame& frame, ActiveRegion& active) const
+	{
+		edgefixer_type type = vi.ComponentSize() == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+		int detect_planes = vi.IsRGB() ? PLANAR_R | PLANAR_G | PLANAR_B : PLANAR_Y;
+		int left = INT_MAX, top = INT_MAX, right = -1, bottom = -1;
+
+		while (detect_planes)
+		{
+			int plane = detect_planes & -detect_planes; // extract lowest bit
+			detect_planes &= ~plane;
+
+			int pitch = frame->GetPitch(plane);
+			int x, y, w, h;
+			if (edgefixer_detect_active(type, frame->GetReadPtr(plane) + RegionOffset(active, pitch), pitch, active.width, active.height, p.detect, &x, &y, &w, &h))
+			{
+				left = std::min(left, x);
+				top = std::min(top, y);
+				right = std::max(right, x + w);
+				bottom = std::max(bottom, y + h);
+			}
 		}
+		if (right < 0)
+			return false;
+
+		int xalign = m_ref_scale_x << SubsamplingW(m_planes & PLANAR_U);
+		int yalign = (m_fields * m_ref_scale_y) << SubsamplingH(m_planes & PLANAR_U);
+		left -= left % xalign;
+		top -= top % yalign;
+		right = std::min(active.width, (right + xalign - 1) / xalign * xalign);
+		bottom = std::min(active.height, (bottom + yalign - 1) / yalign * yalign);
+
+		active.x += left;
+		active.y += top;
+		active.width = right - left;
+		active.height = bottom - top;
+		return EdgesFit(p, active);
 	}
-};
 
-class ReferenceFixer: public GenericVideoFilter {
-	PClip m_reference;
-	int m_left;
-	int m_top;
-	int m_right;
-	int m_bottom;
-	int m_radius;
-	int m_cleft;
-	int m_ctop;
-	int m_cright;
-	int m_cbottom;
-	int m_planes;
-public:
-	ReferenceFixer(PClip _child, PClip reference, int left, int top, int right, int bottom, int radius, int cleft, int ctop, int cright, int cbottom)
-		: GenericVideoFilter(_child), m_reference(reference), m_left(left), m_top(top), m_right(right), m_bottom(bottom), m_radius(radius), m_cleft(cleft), m_ctop(ctop), m_cright(cright), m_cbottom(cbottom)
+	// Height of field f when a plane is split into fields by doubling the pitch.
+	int FieldHeight(int height, int f) const
+	{
+		return (height + m_fields - 1 - f) / m_fields;
+	}
+
+	// Attaches the fit of every line as frame properties, without touching
+	// the samples. Properties of chroma and RGB planes carry a plane prefix.
+	// With fields, each property lists the lines of the top field followed
+	// by those of the bottom field. With detect, the detected region is
+	// attached too.
+	void Measure(const EdgeFixerParams& p, PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp, IScriptEnvironment *env)
 	{
-		if (cleft | ctop | cright | cbottom)
+		static const char *const edge_names[4] = { "Top", "Bottom", "Left", "Right" };
+		const char *worst_edge = 0;
+		const char *worst_plane = "";
+		int worst_line = 0;
+		double worst_change = -1;
+
+		env->MakePropertyWritable(&frame);
+		AVSMap *props = env->getFramePropsRW(frame);
+
+		int planes_todo = m_planes;
+		while (planes_todo)
 		{
-			m_planes = PLANAR_Y | PLANAR_U | PLANAR_V;
+			int plane = planes_todo & -planes_todo; // extract lowest bit
+			const char *prefix = plane == PLANAR_U ? "U" : plane == PLANAR_V ? "V" :
+				plane == PLANAR_R ? "R" : plane == PLANAR_G ? "G" : plane == PLANAR_B ? "B" : "";
+			planes_todo &= ~plane;
+
+			int counts[4];
+			GetEdges(p, plane, counts[2], counts[0], counts[3], counts[1]);
+
+			int num_lines = counts[0] + counts[1] + counts[2] + counts[3];
+			if (!num_lines)
+				continue;
+			std::vector<edgefixer_edge_stats> stats(num_lines * m_fields);
+			MeasurePlane(p, plane, frame, ref_frame, active, type, tmp, &stats[0]);
+
+			const edgefixer_edge_stats *s = &stats[0];
+			for (int edge = 0; edge < 4; ++edge)
+			{
+				char slope_key[48], offset_key[48], residual_key[48];
+				snprintf(slope_key, sizeof(slope_key), "EdgeFixer%s%sSlopeDeviation", prefix, edge_names[edge]);
+				snprintf(offset_key, sizeof(offset_key), "EdgeFixer%s%sOffset", prefix, edge_names[edge]);
+				snprintf(residual_key, sizeof(residual_key), "EdgeFixer%s%sResidual", prefix, edge_names[edge]);
+
+				for (int f = 0; f < m_fields; ++f)
+				{
+					const edgefixer_edge_stats *fs = s + f * num_lines;
+					for (int i = 0; i < counts[edge]; ++i)
+					{
+						int append = f || i ? PROPAPPENDMODE_APPEND : PROPAPPENDMODE_REPLACE;
+						double change = sqrt(fs[i].correction);
+
+						env->propSetFloat(props, slope_key, fs[i].slope - 1.0, append);
+						env->propSetFloat(props, offset_key, fs[i].offset, append);
+						env->propSetFloat(props, residual_key, fs[i].residual, append);
+
+						if (change > worst_change)
+						{
+							worst_edge = edge_names[edge];
+							worst_plane = prefix;
+							worst_line = f * counts[edge] + i;
+							worst_change = change;
+						}
+					}
+				}
+				s += counts[edge];
+			}
 		}
-		else if (vi.IsYUV() || vi.IsYUVA())
+
+		if (worst_edge)
 		{
-			m_planes = PLANAR_Y;
+			char edge[8];
+			snprintf(edge, sizeof(edge), "%s%s", worst_plane, worst_edge);
+			env->propSetData(props, "EdgeFixerWorstEdge", edge, -1, PROPAPPENDMODE_REPLACE);
+			env->propSetInt(props, "EdgeFixerWorstLine", worst_line, PROPAPPENDMODE_REPLACE);
+			env->propSetFloat(props, "EdgeFixerWorstChange", worst_change, PROPAPPENDMODE_REPLACE);
 		}
-		else
+
+		if (p.detect >= 0)
 		{
-			m_planes = PLANAR_R | PLANAR_G | PLANAR_B;
+			env->propSetInt(props, "EdgeFixerActive", active.x, PROPAPPENDMODE_REPLACE);
+			env->propSetInt(props, "EdgeFixerActive", active.y, PROPAPPENDMODE_APPEND);
+			env->propSetInt(props, "EdgeFixerActive", active.width, PROPAPPENDMODE_APPEND);
+			env->propSetInt(props, "EdgeFixerActive", active.height, PROPAPPENDMODE_APPEND);
 		}
 	}
 
+	virtual PVideoFrame GetReference(int n, IScriptEnvironment *env) = 0;
+	// Plane functions process every field of the active region; MeasurePlane
+	// writes the stats of each field in turn.
+	virtual void MeasurePlane(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp, edgefixer_edge_stats *stats) = 0;
+	virtual bool PlaneChanges(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp) = 0;
+	virtual void ProcessPlane(const EdgeFixerParams& p, int plane, PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp) = 0;
+
+public:
 	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env)
 	{
 		PVideoFrame frame = child->GetFrame(n, env);
-		env->MakeWritable(&frame);
+		if (Cropping())
+			frame = Crop(frame, env);
+		if (n < m_params.first || n > m_params.last)
+			return frame;
+
+		EdgeFixerParams p = FrameParams(n, frame, env);
+		ActiveRegion active = m_active;
+		if (!HasEdges(p) || (p.detect >= 0 && !Detect(p, frame, active)))
+			return frame;
 
-		int step = vi.ComponentSize();
-		size_t (*required_buffer)(int) = step == 2 ? edgefixer_required_buffer_w : edgefixer_required_buffer_b;
+		edgefixer_type type = vi.ComponentSize() == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
 
-		void *tmp = malloc(required_buffer(vi.width > vi.height ? vi.width : vi.height));
+		void *tmp = malloc(RefScaled() ? edgefixer_required_buffer_scaled(type, vi.width, vi.height) : edgefixer_required_buffer(type, vi.width, vi.height));
 		if (!tmp)
-			env->ThrowError("[ReferenceFixer] error allocating temporary buffer");
+			env->ThrowError("[%s] error allocating temporary buffer", m_name);
+
+		PVideoFrame ref_frame = GetReference(n, env);
+
+		if (m_params.measure)
+		{
+			Measure(p, frame, ref_frame, active, type, tmp, env);
+			free(tmp);
+			return frame;
+		}
+
+		if (m_params.passthrough)
+		{
+			bool changes = false;
+			int planes_todo = m_planes;
+			while (planes_todo && !changes)
+			{
+				int plane = planes_todo & -planes_todo; // extract lowest bit
+				changes = PlaneChanges(p, plane, frame, ref_frame, active, type, tmp);
+				planes_todo &= ~plane;
+			}
+			if (!changes)
+			{
+				free(tmp);
+				return frame;
+			}
+		}
+
+		env->MakeWritable(&frame);
 
-		PVideoFrame ref_frame = m_reference->GetFrame(n, env);
 		int planes_todo = m_planes;
 		while (planes_todo)
 		{
 			int plane = planes_todo & -planes_todo; // extract lowest bit
-			ProcessPlane(plane, frame, ref_frame, step, tmp);
+			ProcessPlane(p, plane, frame, ref_frame, active, type, tmp);
 			planes_todo &= ~plane;
 		}
 
@@ -168,54 +545,288 @@ public:
 
 		return frame;
 	}
+};
+
+class ContinuityFixer: public EdgeFixerBase {
+public:
+	ContinuityFixer(PClip _child, const EdgeFixerParams& params, IScriptEnvironment *env)
+		: EdgeFixerBase(_child, params, "ContinuityFixer", env)
+	{
+	}
 private:
-	void ProcessPlane(int plane, PVideoFrame& frame, PVideoFrame& ref_frame, int step, void *tmp)
+	PVideoFrame GetReference(int n, IScriptEnvironment *env)
+	{
+		return PVideoFrame();
+	}
+
+	bool PlaneChanges(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp)
 	{
-		int width = frame->GetRowSize(plane) / step;
-		int height = frame->GetHeight(plane);
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
 		int stride = frame->GetPitch(plane);
 
-		void (*process_edge)(void *, const void *, int, int, int, int, void *) = step == 2 ? edgefixer_process_edge_w : edgefixer_process_edge_b;
+		int left, top, right, bottom;
+		GetEdges(p, plane, left, top, right, bottom);
 
-		BYTE *write_ptr = frame->GetWritePtr(plane);
-		int ref_stride = ref_frame->GetPitch(plane);
-		const BYTE *read_ptr = ref_frame->GetReadPtr(plane);
+		const BYTE *ptr = frame->GetReadPtr(plane) + RegionOffset(r, stride);
+		for (int f = 0; f < m_fields; ++f)
+		{
+			bool changes = p.sample > 1
+				? !!edgefixer_continuity_sampled_changes(type, ptr + f * stride, stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.sample, tmp)
+				: !!edgefixer_continuity_changes(type, ptr + f * stride, stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp);
+			if (changes)
+				return true;
+		}
+		return false;
+	}
+
+	void MeasurePlane(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp, edgefixer_edge_stats *stats)
+	{
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
+		int stride = frame->GetPitch(plane);
 
 		int left, top, right, bottom;
-		if (plane == PLANAR_U || plane == PLANAR_V)
+		GetEdges(p, plane, left, top, right, bottom);
+
+		const BYTE *ptr = frame->GetReadPtr(plane) + RegionOffset(r, stride);
+		for (int f = 0; f < m_fields; ++f)
+			edgefixer_continuity_measure(type, ptr + f * stride, stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp, stats + f * (left + top + right + bottom));
+	}
+
+	void ProcessPlane(const EdgeFixerParams& p, int plane, PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp)
+	{
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
+		int stride = frame->GetPitch(plane);
+
+		BYTE *ptr = frame->GetWritePtr(plane) + RegionOffset(r, stride);
+
+		int left, top, right, bottom;
+		GetEdges(p, plane, left, top, right, bottom);
+
+		for (int f = 0; f < m_fields; ++f)
 		{
-			left = m_cleft;
-			top = m_ctop;
-			right = m_cright;
-			bottom = m_cbottom;
+			if (p.sample > 1)
+				edgefixer_continuity_sampled(type, ptr + f * stride, stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.sample, tmp);
+			else
+				edgefixer_continuity(type, ptr + f * stride, stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp);
 		}
-		else
+	}
+};
+
+class ReferenceFixer: public EdgeFixerBase {
+	PClip m_reference;
+public:
+	ReferenceFixer(PClip _child, PClip reference, const EdgeFixerParams& params, IScriptEnvironment *env)
+		: EdgeFixerBase(_child, params, "ReferenceFixer", env), m_reference(reference)
+	{
+		const VideoInfo& ref_vi = reference->GetVideoInfo();
+		m_ref_scale_x = child->GetVideoInfo().width / ref_vi.width;
+		m_ref_scale_y = child->GetVideoInfo().height / ref_vi.height;
+	}
+private:
+	PVideoFrame GetReference(int n, IScriptEnvironment *env)
+	{
+		PVideoFrame frame = m_reference->GetFrame(n, env);
+		return Cropping() ? Crop(frame, env, m_ref_scale_x, m_ref_scale_y) : frame;
+	}
+
+	bool PlaneChanges(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp)
+	{
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
+		int stride = frame->GetPitch(plane);
+		int ref_stride = ref_frame->GetPitch(plane);
+
+		int left, top, right, bottom;
+		GetEdges(p, plane, left, top, right, bottom);
+
+		const BYTE *ptr = frame->GetReadPtr(plane) + RegionOffset(r, stride);
+		ActiveRegion rr = RefRegion(r);
+		const BYTE *ref_ptr = ref_frame->GetReadPtr(plane) + RegionOffset(rr, ref_stride);
+		for (int f = 0; f < m_fields; ++f)
 		{
-			left = m_left;
-			top = m_top;
-			right = m_right;
-			bottom = m_bottom;
+			bool changes = RefScaled()
+				? !!edgefixer_reference_scaled_changes(type, ptr + f * stride, stride * m_fields, ref_ptr + f * ref_stride, ref_stride * m_fields, rr.width, FieldHeight(rr.height, f), width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp)
+				: p.sample > 1
+				? !!edgefixer_reference_sampled_changes(type, ptr + f * stride, stride * m_fields, ref_ptr + f * ref_stride, ref_stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.sample, tmp)
+				: !!edgefixer_reference_changes(type, ptr + f * stride, stride * m_fields, ref_ptr + f * ref_stride, ref_stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp);
+			if (changes)
+				return true;
 		}
+		return false;
+	}
 
-		// top
-		for (int i = 0; i < top; ++i) {
-			process_edge(write_ptr + stride * i, read_ptr + ref_stride * i, step, step, width, m_radius, tmp);
-		}
-		// bottom
-		for (int i = 0; i < bottom; ++i) {
-			process_edge(write_ptr + stride * (height - i - 1), read_ptr + ref_stride * (height - i - 1), step, step, width, m_radius, tmp);
+	void MeasurePlane(const EdgeFixerParams& p, int plane, const PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp, edgefixer_edge_stats *stats)
+	{
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
+		int stride = frame->GetPitch(plane);
+		int ref_stride = ref_frame->GetPitch(plane);
+
+		int left, top, right, bottom;
+		GetEdges(p, plane, left, top, right, bottom);
+
+		const BYTE *ptr = frame->GetReadPtr(plane) + RegionOffset(r, stride);
+		ActiveRegion rr = RefRegion(r);
+		const BYTE *ref_ptr = ref_frame->GetReadPtr(plane) + RegionOffset(rr, ref_stride);
+		for (int f = 0; f < m_fields; ++f)
+		{
+			if (RefScaled())
+				edgefixer_reference_scaled_measure(type, ptr + f * stride, stride * m_fields, ref_ptr + f * ref_stride, ref_stride * m_fields, rr.width, FieldHeight(rr.height, f), width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp, stats + f * (left + top + right + bottom));
+			else
+				edgefixer_reference_measure(type, ptr + f * stride, stride * m_fields, ref_ptr + f * ref_stride, ref_stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp, stats + f * (left + top + right + bottom));
 		}
-		// left
-		for (int i = 0; i < left; ++i) {
-			process_edge(write_ptr + step * i, read_ptr + step * i, stride, ref_stride, height, m_radius, tmp);
+	}
+
+	void ProcessPlane(const EdgeFixerParams& p, int plane, PVideoFrame& frame, const PVideoFrame& ref_frame, const ActiveRegion& active, edgefixer_type type, void *tmp)
+	{
+		ActiveRegion r = PlaneRegion(plane, active);
+		int width = r.width;
+		int height = r.height;
+		int stride = frame->GetPitch(plane);
+
+		BYTE *write_ptr = frame->GetWritePtr(plane) + RegionOffset(r, stride);
+		int ref_stride = ref_frame->GetPitch(plane);
+		ActiveRegion rr = RefRegion(r);
+		const BYTE *read_ptr = ref_frame->GetReadPtr(plane) + RegionOffset(rr, ref_stride);
+
+		int left, top, right, bottom;
+		GetEdges(p, plane, left, top, right, bottom);
+
+		for (int f = 0; f < m_fields; ++f)
+		{
+			if (RefScaled())
+				edgefixer_reference_scaled(type, write_ptr + f * stride, stride * m_fields, read_ptr + f * ref_stride, ref_stride * m_fields, rr.width, FieldHeight(rr.height, f), width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp);
+			else if (p.sample > 1)
+				edgefixer_reference_sampled(type, write_ptr + f * stride, stride * m_fields, read_ptr + f * ref_stride, ref_stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.sample, tmp);
+			else
+				edgefixer_reference(type, write_ptr + f * stride, stride * m_fields, read_ptr + f * ref_stride, ref_stride * m_fields, width, FieldHeight(height, f), left, top, right, bottom, p.radius, tmp);
 		}
-		// right
-		for (int i = 0; i < right; ++i) {
-			process_edge(write_ptr + step * (width - i - 1), read_ptr + step * (width - i - 1), stride, ref_stride, height, m_radius, tmp);
+	}
+};
+
+// One edge specification of MultiFixer: ref is an index into its reference
+// clips, or -1 for continuity; planes is a mask of plane indices.
+struct MultiFixerSpec {
+	int ref;
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int radius;
+	int planes;
+};
+
+// Applies every spec in order to a single writable copy of the frame, so each
+// sees the lines fixed by those before it, as with chained filters.
+class MultiFixer: public GenericVideoFilter {
+	std::vector<PClip> m_refs;
+	std::vector<MultiFixerSpec> m_specs;
+
+	int PlaneOf(int index) const
+	{
+		static const int yuv_planes[3] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+		static const int rgb_planes[3] = { PLANAR_R, PLANAR_G, PLANAR_B };
+		return vi.IsRGB() ? rgb_planes[index] : yuv_planes[index];
+	}
+public:
+	MultiFixer(PClip _child, const std::vector<PClip>& refs, const std::vector<MultiFixerSpec>& specs)
+		: GenericVideoFilter(_child), m_refs(refs), m_specs(specs)
+	{
+	}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env)
+	{
+		PVideoFrame frame = child->GetFrame(n, env);
+		std::vector<PVideoFrame> ref_frames(m_refs.size());
+		edgefixer_type type = vi.ComponentSize() == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+
+		void *tmp = malloc(edgefixer_required_buffer(type, vi.width, vi.height));
+		if (!tmp)
+			env->ThrowError("[MultiFixer] error allocating temporary buffer");
+
+		env->MakeWritable(&frame);
+
+		for (size_t i = 0; i < m_specs.size(); ++i)
+		{
+			const MultiFixerSpec& spec = m_specs[i];
+			if (spec.ref >= 0 && !ref_frames[spec.ref])
+				ref_frames[spec.ref] = m_refs[spec.ref]->GetFrame(n, env);
+
+			for (int index = 0; index < vi.NumComponents() && index < 3; ++index)
+			{
+				if (!(spec.planes & (1 << index)))
+					continue;
+
+				int plane = PlaneOf(index);
+				int width = frame->GetRowSize(plane) / vi.ComponentSize();
+				int height = frame->GetHeight(plane);
+
+				if (spec.ref >= 0)
+					edgefixer_reference(type, frame->GetWritePtr(plane), frame->GetPitch(plane), ref_frames[spec.ref]->GetReadPtr(plane), ref_frames[spec.ref]->GetPitch(plane), width, height, spec.left, spec.top, spec.right, spec.bottom, spec.radius, tmp);
+				else
+					edgefixer_continuity(type, frame->GetWritePtr(plane), frame->GetPitch(plane), width, height, spec.left, spec.top, spec.right, spec.bottom, spec.radius, tmp);
+			}
 		}
+
+		free(tmp);
+
+		return frame;
 	}
 };
 
+static bool NothingToFix(const EdgeFixerParams& p)
+{
+	return !(p.left | p.top | p.right | p.bottom | p.cleft | p.ctop | p.cright | p.cbottom | p.cropleft | p.croptop | p.cropright | p.cropbottom) && !*p.zones && !p.frameprops;
+}
+
+static void CheckParams(const VideoInfo& vi, const EdgeFixerParams& p, const char *name, IScriptEnvironment *env)
+{
+	if (p.sample < 1)
+		env->ThrowError("[%s] sample must be at least 1", name);
+	if (p.sample > 1 && p.radius)
+		env->ThrowError("[%s] sample requires radius 0", name);
+	if (p.cropleft < 0 || p.croptop < 0 || p.cropright < 0 || p.cropbottom < 0)
+		env->ThrowError("[%s] crop margins must not be negative", name);
+	if (p.cropleft + p.cropright >= vi.width || p.croptop + p.cropbottom >= vi.height)
+		env->ThrowError("[%s] cropped frame would be empty", name);
+	if (vi.NumComponents() > 1 && !vi.IsRGB())
+	{
+		int xmask = (1 << vi.GetPlaneWidthSubsampling(PLANAR_U)) - 1;
+		int ymask = (1 << vi.GetPlaneHeightSubsampling(PLANAR_U)) - 1;
+		if ((p.cropleft | p.cropright) & xmask || (p.croptop | p.cropbottom) & ymask)
+			env->ThrowError("[%s] crop margins must be a multiple of the chroma subsampling", name);
+	}
+
+	// The active region is relative to the output; 0 extends it to the far border.
+	int width = vi.width - p.cropleft - p.cropright;
+	int height = vi.height - p.croptop - p.cropbottom;
+	int active_width = p.activewidth ? p.activewidth : width - p.activex;
+	int active_height = p.activeheight ? p.activeheight : height - p.activey;
+	if (p.activex < 0 || p.activey < 0 || active_width <= 0 || active_height <= 0 || p.activex + active_width > width || p.activey + active_height > height)
+		env->ThrowError("[%s] active region must lie within the frame", name);
+	if (p.fields && p.activey % 2)
+		env->ThrowError("[%s] active region must start on a top field line", name);
+	if ((p.cleft | p.ctop | p.cright | p.cbottom) && vi.NumComponents() > 1 && !vi.IsRGB())
+	{
+		int xmask = (1 << vi.GetPlaneWidthSubsampling(PLANAR_U)) - 1;
+		int ymask = ((p.fields ? 2 : 1) << vi.GetPlaneHeightSubsampling(PLANAR_U)) - 1;
+		if ((p.activex | active_width) & xmask || (p.activey | active_height) & ymask)
+			env->ThrowError("[%s] active region must be a multiple of the chroma subsampling", name);
+	}
+
+	std::vector<EdgeFixerZone> zones;
+	if (!ParseZones(p.zones, zones))
+		env->ThrowError("[%s] zones must hold 7 values per zone: first, last, left, top, right, bottom, radius", name);
+}
+
 AVSValue __cdecl Create_ContinuityFixer(AVSValue args, void *user_data, IScriptEnvironment *env)
 {
 	PClip clip = args[0].AsClip();
@@ -225,17 +836,18 @@ AVSValue __cdecl Create_ContinuityFixer(AVSValue args, void *user_data, IScriptE
 	if (vi.ComponentSize() > 2)
 		env->ThrowError("[ContinuityFixer] input clip must be at most 16-bit");
 
-	int cleft = args[6].AsInt(0);
-	int ctop = args[7].AsInt(0);
-	int cright = args[8].AsInt(0);
-	int cbottom = args[9].AsInt(0);
-	if (cleft | ctop | cright | cbottom)
+	EdgeFixerParams params = ReadParams(args, 1);
+	CheckParams(vi, params, "ContinuityFixer", env);
+	if (params.cleft | params.ctop | params.cright | params.cbottom)
 	{
 		if (vi.IsY() || !(vi.IsYUV() || vi.IsYUVA()))
 			env->ThrowError("[ContinuityFixer] input clip must contain UV planes to process chroma");
 	}
 
-	return new ContinuityFixer(clip, args[1].AsInt(0), args[2].AsInt(0), args[3].AsInt(0), args[4].AsInt(0), args[5].AsInt(0), cleft, ctop, cright, cbottom);
+	if (NothingToFix(params))
+		return clip;
+
+	return new ContinuityFixer(clip, params, env);
 }
 
 AVSValue __cdecl Create_ReferenceFixer(AVSValue args, void *user_data, IScriptEnvironment *env)
@@ -246,8 +858,9 @@ AVSValue __cdecl Create_ReferenceFixer(AVSValue args, void *user_data, IScriptEn
 	const VideoInfo& vi2 = clip2->GetVideoInfo();
 	if (!vi1.IsPlanar() || !vi2.IsPlanar())
 		env->ThrowError("[ReferenceFixer] clips must be planar");
-	if (vi1.width != vi2.width || vi1.height != vi2.height)
-		env->ThrowError("[ReferenceFixer] clips must have same dimensions");
+	// The reference may be smaller by a whole factor, such as half or quarter size.
+	if (!vi2.width || !vi2.height || vi1.width % vi2.width || vi1.height % vi2.height)
+		env->ThrowError("[ReferenceFixer] reference size must divide the clip's");
 	if (vi1.ComponentSize() > 2 || vi2.ComponentSize() > 2)
 		env->ThrowError("[ReferenceFixer] clips must be at most 16-bit");
 	if (vi1.BitsPerComponent() != vi2.BitsPerComponent())
@@ -255,11 +868,33 @@ AVSValue __cdecl Create_ReferenceFixer(AVSValue args, void *user_data, IScriptEn
 	if (!!vi1.IsRGB() != !!vi2.IsRGB())
 		env->ThrowError("[ReferenceFixer] clips must be both RGB or both YUV");
 
-	int cleft = args[7].AsInt(0);
-	int ctop = args[8].AsInt(0);
-	int cright = args[9].AsInt(0);
-	int cbottom = args[10].AsInt(0);
-	if (cleft | ctop | cright | cbottom)
+	EdgeFixerParams params = ReadParams(args, 2);
+	CheckParams(vi1, params, "ReferenceFixer", env);
+	int scale_x = vi1.width / vi2.width;
+	int scale_y = vi1.height / vi2.height;
+	if (scale_x > 1 || scale_y > 1)
+	{
+		if (params.sample > 1)
+			env->ThrowError("[ReferenceFixer] sample requires a full-size reference");
+		// Reference rows split into fields would not lie on the field's parity.
+		if (params.fields && scale_y > 1)
+			env->ThrowError("[ReferenceFixer] fields requires a reference of the clip's height");
+		if (vi1.NumComponents() > 1 && !vi1.IsRGB() && (vi1.GetPlaneWidthSubsampling(PLANAR_U) != vi2.GetPlaneWidthSubsampling(PLANAR_U) || vi1.GetPlaneHeightSubsampling(PLANAR_U) != vi2.GetPlaneHeightSubsampling(PLANAR_U)))
+			env->ThrowError("[ReferenceFixer] a scaled reference must have the clip's subsampling");
+
+		// Crop margins and the active region must map to whole reference samples in every plane.
+		bool chroma = !!(params.cleft | params.ctop | params.cright | params.cbottom);
+		int xalign = scale_x << (chroma ? vi1.GetPlaneWidthSubsampling(PLANAR_U) : 0);
+		int yalign = scale_y << (chroma ? vi1.GetPlaneHeightSubsampling(PLANAR_U) : 0);
+		int width = vi1.width - params.cropleft - params.cropright;
+		int height = vi1.height - params.croptop - params.cropbottom;
+		int active_width = params.activewidth ? params.activewidth : width - params.activex;
+		int active_height = params.activeheight ? params.activeheight : height - params.activey;
+		if (params.cropleft % xalign || params.cropright % xalign || params.activex % xalign || active_width % xalign ||
+			params.croptop % yalign || params.cropbottom % yalign || params.activey % (yalign * (params.fields ? 2 : 1)) || active_height % yalign)
+			env->ThrowError("[ReferenceFixer] crop margins and active region must be a multiple of the reference scale");
+	}
+	if (params.cleft | params.ctop | params.cright | params.cbottom)
 	{
 		if (vi1.IsY() || vi2.IsY() || !(vi1.IsYUV() || vi1.IsYUVA()) || !(vi2.IsYUV() || vi2.IsYUVA()))
 			env->ThrowError("[ReferenceFixer] clips must contain UV planes to process chroma");
@@ -267,7 +902,60 @@ AVSValue __cdecl Create_ReferenceFixer(AVSValue args, void *user_data, IScriptEn
 			env->ThrowError("[ReferenceFixer] clips must have same subsampling to process chroma");
 	}
 
-	return new ReferenceFixer(clip1, clip2, args[2].AsInt(0), args[3].AsInt(0), args[4].AsInt(0), args[5].AsInt(0), args[6].AsInt(0), cleft, ctop, cright, cbottom);
+	if (NothingToFix(params))
+		return clip1;
+
+	return new ReferenceFixer(clip1, clip2, params, env);
+}
+
+AVSValue __cdecl Create_MultiFixer(AVSValue args, void *user_data, IScriptEnvironment *env)
+{
+	PClip clip = args[0].AsClip();
+	const VideoInfo& vi = clip->GetVideoInfo();
+	if (!vi.IsPlanar())
+		env->ThrowError("[MultiFixer] clips must be planar");
+	if (vi.ComponentSize() > 2)
+		env->ThrowError("[MultiFixer] clips must be at most 16-bit");
+
+	std::vector<PClip> refs;
+	for (int i = 0; i < args[2].ArraySize(); ++i)
+	{
+		PClip ref = args[2][i].AsClip();
+		const VideoInfo& ref_vi = ref->GetVideoInfo();
+		if (ref_vi.width != vi.width || ref_vi.height != vi.height || !ref_vi.IsSameColorspace(vi))
+			env->ThrowError("[MultiFixer] clip and references must have same dimensions and format");
+		refs.push_back(ref);
+	}
+
+	std::vector<int> values = ParseInts(args[1].AsString(""));
+	if (values.empty() || values.size() % 7)
+		env->ThrowError("[MultiFixer] specs must hold 7 values per spec: ref, left, top, right, bottom, radius, planes");
+
+	int num_planes = std::min(vi.NumComponents(), 3);
+	std::vector<MultiFixerSpec> specs;
+	for (size_t i = 0; i < values.size(); i += 7)
+	{
+		MultiFixerSpec spec = { values[i], values[i + 1], values[i + 2], values[i + 3], values[i + 4], values[i + 5], values[i + 6] };
+		int index = (int)(i / 7);
+
+		if (spec.ref < -1 || spec.ref >= (int)refs.size())
+			env->ThrowError("[MultiFixer] spec %d: ref must be -1 or an index into the reference clips", index);
+		if (spec.planes <= 0 || spec.planes >> num_planes)
+			env->ThrowError("[MultiFixer] spec %d: planes must select planes of the clip", index);
+		if (spec.left < 0 || spec.top < 0 || spec.right < 0 || spec.bottom < 0)
+			env->ThrowError("[MultiFixer] spec %d: too few edges to fix", index);
+		for (int p = 0; p < num_planes; ++p)
+		{
+			bool chroma = p && !vi.IsRGB();
+			int plane_width = vi.width >> (chroma ? vi.GetPlaneWidthSubsampling(PLANAR_U) : 0);
+			int plane_height = vi.height >> (chroma ? vi.GetPlaneHeightSubsampling(PLANAR_U) : 0);
+			if (spec.planes & (1 << p) && (std::max(spec.left, spec.right) > plane_width || std::max(spec.top, spec.bottom) > plane_height))
+				env->ThrowError("[MultiFixer] spec %d: too many edges to fix", index);
+		}
+		specs.push_back(spec);
+	}
+
+	return new MultiFixer(clip, refs, specs);
 }
 
 extern "C" __declspec(dllexport)
@@ -275,7 +963,8 @@ const char * __stdcall AvisynthPluginInit3(IScriptEnvironment *env, const AVS_Li
 {
 	AVS_linkage = vectors;
 
-	env->AddFunction("ContinuityFixer", "c[left]i[top]i[right]i[bottom]i[radius]i[cleft]i[ctop]i[cright]i[cbottom]i", Create_ContinuityFixer, NULL);
-	env->AddFunction("ReferenceFixer", "cc[left]i[top]i[right]i[bottom]i[radius]i[cleft]i[ctop]i[cright]i[cbottom]i", Create_ReferenceFixer, NULL);
+	env->AddFunction("ContinuityFixer", "c[left]i[top]i[right]i[bottom]i[radius]i[cleft]i[ctop]i[cright]i[cbottom]i[first]i[last]i[passthrough]b[measure]b[fields]b[cropleft]i[croptop]i[cropright]i[cropbottom]i[sample]i[activex]i[activey]i[activewidth]i[activeheight]i[detect]i[zones]s[frameprops]b", Create_ContinuityFixer, NULL);
+	env->AddFunction("ReferenceFixer", "cc[left]i[top]i[right]i[bottom]i[radius]i[cleft]i[ctop]i[cright]i[cbottom]i[first]i[last]i[passthrough]b[measure]b[fields]b[cropleft]i[croptop]i[cropright]i[cropbottom]i[sample]i[activex]i[activey]i[activewidth]i[activeheight]i[detect]i[zones]s[frameprops]b", Create_ReferenceFixer, NULL);
+	env->AddFunction("MultiFixer", "csc*", Create_MultiFixer, NULL);
 	return "EdgeFixer";
 }
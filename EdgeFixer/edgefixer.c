@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "edgefixer.h"
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
@@ -19,16 +20,28 @@ typedef struct least_squares_data64 {
 	int64_t integral_xsqr;
 } least_squares_data64;
 
+typedef struct least_squares_dataf {
+	double integral_x;
+	double integral_y;
+	double integral_xy;
+	double integral_xsqr;
+} least_squares_dataf;
+
+/* The numerator and denominator are computed exactly in 64-bit integers, as
+ * their terms cancel almost completely on long lines and would lose most of
+ * their bits in float. Only the final division is done in floating point. */
 static void least_squares(int n, least_squares_data *d, float *a, float *b)
 {
-	float interval_x = (float)(d[n - 1].integral_x - d[0].integral_x);
-	float interval_y = (float)(d[n - 1].integral_y - d[0].integral_y);
-	float interval_xy = (float)(d[n - 1].integral_xy - d[0].integral_xy);
-	float interval_xsqr = (float)(d[n - 1].integral_xsqr - d[0].integral_xsqr);
+	int64_t interval_x = d[n - 1].integral_x - d[0].integral_x;
+	int64_t interval_y = d[n - 1].integral_y - d[0].integral_y;
+	int64_t interval_xy = d[n - 1].integral_xy - d[0].integral_xy;
+	int64_t interval_xsqr = d[n - 1].integral_xsqr - d[0].integral_xsqr;
+	double slope;
 
 	/* Add 0.001f to denominator to prevent division by zero. */
-	*a = ((float)n * interval_xy - interval_x * interval_y) / ((interval_xsqr * (float)n - interval_x * interval_x) + 0.001f);
-	*b = (interval_y - *a * interval_x) / (float)n;
+	slope = (double)(n * interval_xy - interval_x * interval_y) / ((double)(interval_xsqr * n - interval_x * interval_x) + 0.001f);
+	*a = (float)slope;
+	*b = (float)(((double)interval_y - slope * (double)interval_x) / n);
 }
 
 static void least_squares64(int n, least_squares_data64 *d, double *a, double *b)
@@ -43,6 +56,18 @@ static void least_squares64(int n, least_squares_data64 *d, double *a, double *b
 	*b = (interval_y - *a * interval_x) / (double)n;
 }
 
+static void least_squaresf(int n, least_squares_dataf *d, double *a, double *b)
+{
+	double interval_x = d[n - 1].integral_x - d[0].integral_x;
+	double interval_y = d[n - 1].integral_y - d[0].integral_y;
+	double interval_xy = d[n - 1].integral_xy - d[0].integral_xy;
+	double interval_xsqr = d[n - 1].integral_xsqr - d[0].integral_xsqr;
+
+	/* Float samples are normalized, so the bias must be much smaller. */
+	*a = ((double)n * interval_xy - interval_x * interval_y) / ((interval_xsqr * (double)n - interval_x * interval_x) + 1e-12);
+	*b = (interval_y - *a * interval_x) / (double)n;
+}
+
 static uint8_t float_to_u8(float x)
 {
 	return (uint8_t)lrintf(MIN(MAX(x, 0), UINT8_MAX));
@@ -53,39 +78,91 @@ static uint16_t double_to_u16(double x)
 	return (uint16_t)lrint(MIN(MAX(x, 0), UINT16_MAX));
 }
 
-size_t edgefixer_required_buffer_b(int n)
+static void integrate_b(const uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, least_squares_data *buf)
 {
-	return n * sizeof(least_squares_data);
+	int i;
+
+	buf[0].integral_x = x[0];
+	buf[0].integral_y = y[0];
+	buf[0].integral_xy = x[0] * y[0];
+	buf[0].integral_xsqr = x[0] * x[0];
+
+	for (i = 1; i < n; ++i) {
+		uint16_t _x = x[i * x_dist_to_next / sizeof(uint8_t)];
+		uint16_t _y = y[i * y_dist_to_next / sizeof(uint8_t)];
+
+		buf[i].integral_x = buf[i - 1].integral_x + _x;
+		buf[i].integral_y = buf[i - 1].integral_y + _y;
+		buf[i].integral_xy = buf[i - 1].integral_xy + _x * _y;
+		buf[i].integral_xsqr = buf[i - 1].integral_xsqr + _x * _x;
+	}
 }
 
-size_t edgefixer_required_buffer_w(int n)
+static void integrate_w(const uint16_t *x, const uint16_t *y, int x_dist_to_next, int y_dist_to_next, int n, least_squares_data64 *buf)
 {
-	return n * sizeof(least_squares_data64);
+	int i;
+
+	buf[0].integral_x = x[0];
+	buf[0].integral_y = y[0];
+	buf[0].integral_xy = (long long)x[0] * y[0];
+	buf[0].integral_xsqr = (long long)x[0] * x[0];
+
+	for (i = 1; i < n; ++i) {
+		uint32_t _x = x[i * x_dist_to_next / sizeof(uint16_t)];
+		uint32_t _y = y[i * y_dist_to_next / sizeof(uint16_t)];
+
+		buf[i].integral_x = buf[i - 1].integral_x + _x;
+		buf[i].integral_y = buf[i - 1].integral_y + _y;
+		buf[i].integral_xy = buf[i - 1].integral_xy + _x * _y;
+		buf[i].integral_xsqr = buf[i - 1].integral_xsqr + _x * _x;
+	}
 }
 
-void edgefixer_process_edge_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp)
+static void integrate_f(const float *x, const float *y, int x_dist_to_next, int y_dist_to_next, int n, least_squares_dataf *buf)
 {
-	uint8_t *x = xptr;
-	const uint8_t *y = yptr;
-
-	least_squares_data *buf = (least_squares_data *)tmp;
-	float a, b;
 	int i;
 
 	buf[0].integral_x = x[0];
 	buf[0].integral_y = y[0];
-	buf[0].integral_xy = x[0] * y[0];
-	buf[0].integral_xsqr = x[0] * x[0];
+	buf[0].integral_xy = (double)x[0] * y[0];
+	buf[0].integral_xsqr = (double)x[0] * x[0];
 
 	for (i = 1; i < n; ++i) {
-		uint16_t _x = x[i * x_dist_to_next / sizeof(uint8_t)];
-		uint16_t _y = y[i * y_dist_to_next / sizeof(uint8_t)];
+		double _x = x[i * x_dist_to_next / sizeof(float)];
+		double _y = y[i * y_dist_to_next / sizeof(float)];
 
 		buf[i].integral_x = buf[i - 1].integral_x + _x;
 		buf[i].integral_y = buf[i - 1].integral_y + _y;
 		buf[i].integral_xy = buf[i - 1].integral_xy + _x * _y;
 		buf[i].integral_xsqr = buf[i - 1].integral_xsqr + _x * _x;
 	}
+}
+
+size_t edgefixer_required_buffer_b(int n)
+{
+	return n * sizeof(least_squares_data);
+}
+
+size_t edgefixer_required_buffer_w(int n)
+{
+	return n * sizeof(least_squares_data64);
+}
+
+size_t edgefixer_required_buffer_f(int n)
+{
+	return n * sizeof(least_squares_dataf);
+}
+
+void edgefixer_process_edge_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp)
+{
+	uint8_t *x = xptr;
+	const uint8_t *y = yptr;
+
+	least_squares_data *buf = (least_squares_data *)tmp;
+	float a, b;
+	int i;
+
+	integrate_b(x, y, x_dist_to_next, y_dist_to_next, n, buf);
 
 	if (radius) {
 		for (i = 0; i < n; ++i) {
@@ -116,20 +193,7 @@ void edgefixer_process_edge_w(void *xptr, const void *yptr, int x_dist_to_next,
 	double a, b;
 	int i;
 
-	buf[0].integral_x = x[0];
-	buf[0].integral_y = y[0];
-	buf[0].integral_xy = (long long)x[0] * y[0];
-	buf[0].integral_xsqr = (long long)x[0] * x[0];
-
-	for (i = 1; i < n; ++i) {
-		uint32_t _x = x[i * x_dist_to_next / sizeof(uint16_t)];
-		uint32_t _y = y[i * y_dist_to_next / sizeof(uint16_t)];
-
-		buf[i].integral_x = buf[i - 1].integral_x + _x;
-		buf[i].integral_y = buf[i - 1].integral_y + _y;
-		buf[i].integral_xy = buf[i - 1].integral_xy + _x * _y;
-		buf[i].integral_xsqr = buf[i - 1].integral_xsqr + _x * _x;
-	}
+	integrate_w(x, y, x_dist_to_next, y_dist_to_next, n, buf);
 
 	if (radius) {
 		for (i = 0; i < n; ++i) {
@@ -150,3 +214,780 @@ void edgefixer_process_edge_w(void *xptr, const void *yptr, int x_dist_to_next,
 		}
 	}
 }
+
+void edgefixer_process_edge_f(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp)
+{
+	float *x = xptr;
+	const float *y = yptr;
+
+	least_squares_dataf *buf = (least_squares_dataf *)tmp;
+	double a, b;
+	int i;
+
+	integrate_f(x, y, x_dist_to_next, y_dist_to_next, n, buf);
+
+	if (radius) {
+		for (i = 0; i < n; ++i) {
+			int left = i - radius;
+			int right = i + radius;
+
+			if (left < 0)
+				left = 0;
+			if (right > n - 1)
+				right = n - 1;
+			least_squaresf(right - left + 1, buf + left, &a, &b);
+			x[i * x_dist_to_next / sizeof(float)] = (float)(x[i * x_dist_to_next / sizeof(float)] * a + b);
+		}
+	} else {
+		least_squaresf(n, buf, &a, &b);
+		for (i = 0; i < n; ++i) {
+			x[i * x_dist_to_next / sizeof(float)] = (float)(x[i * x_dist_to_next / sizeof(float)] * a + b);
+		}
+	}
+}
+
+/* Lines shorter than this many samples per step are fitted on a smaller step. */
+#define MIN_SAMPLED_FIT 16
+
+static int sampled_count(int n, int *step)
+{
+	if (*step < 1 || n / *step < MIN_SAMPLED_FIT)
+		*step = MAX(n / MIN_SAMPLED_FIT, 1);
+	return (n + *step - 1) / *step;
+}
+
+/* Fit a and b from every step-th sample, then correct every sample. Returns
+ * nonzero if any sample changes; x is only written if write is set. */
+static int sampled_edge_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp, int write)
+{
+	uint8_t *x = xptr;
+	const uint8_t *y = yptr;
+
+	least_squares_data *buf = (least_squares_data *)tmp;
+	int m = sampled_count(n, &step);
+	int changed = 0;
+	float a, b;
+	int i;
+
+	integrate_b(x, y, x_dist_to_next * step, y_dist_to_next * step, m, buf);
+	least_squares(m, buf, &a, &b);
+
+	for (i = 0; i < n; ++i) {
+		uint8_t *p = x + i * x_dist_to_next / sizeof(uint8_t);
+		uint8_t fitted = float_to_u8(*p * a + b);
+
+		changed |= fitted != *p;
+		if (write)
+			*p = fitted;
+	}
+	return changed;
+}
+
+static int sampled_edge_w(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp, int write)
+{
+	uint16_t *x = xptr;
+	const uint16_t *y = yptr;
+
+	least_squares_data64 *buf = (least_squares_data64 *)tmp;
+	int m = sampled_count(n, &step);
+	int changed = 0;
+	double a, b;
+	int i;
+
+	integrate_w(x, y, x_dist_to_next * step, y_dist_to_next * step, m, buf);
+	least_squares64(m, buf, &a, &b);
+
+	for (i = 0; i < n; ++i) {
+		uint16_t *p = x + i * x_dist_to_next / sizeof(uint16_t);
+		uint16_t fitted = double_to_u16(*p * a + b);
+
+		changed |= fitted != *p;
+		if (write)
+			*p = fitted;
+	}
+	return changed;
+}
+
+static int sampled_edge_f(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp, int write)
+{
+	float *x = xptr;
+	const float *y = yptr;
+
+	least_squares_dataf *buf = (least_squares_dataf *)tmp;
+	int m = sampled_count(n, &step);
+	int changed = 0;
+	double a, b;
+	int i;
+
+	integrate_f(x, y, x_dist_to_next * step, y_dist_to_next * step, m, buf);
+	least_squaresf(m, buf, &a, &b);
+
+	for (i = 0; i < n; ++i) {
+		float *p = x + i * x_dist_to_next / sizeof(float);
+		float fitted = (float)(*p * a + b);
+
+		changed |= fitted != *p;
+		if (write)
+			*p = fitted;
+	}
+	return changed;
+}
+
+void edgefixer_process_edge_sampled_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp)
+{
+	sampled_edge_b(xptr, yptr, x_dist_to_next, y_dist_to_next, n, step, tmp, 1);
+}
+
+void edgefixer_process_edge_sampled_w(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp)
+{
+	sampled_edge_w(xptr, yptr, x_dist_to_next, y_dist_to_next, n, step, tmp, 1);
+}
+
+void edgefixer_process_edge_sampled_f(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp)
+{
+	sampled_edge_f(xptr, yptr, x_dist_to_next, y_dist_to_next, n, step, tmp, 1);
+}
+
+static void init_stats(edgefixer_edge_stats *stats, double a, double b)
+{
+	stats->slope = a;
+	stats->offset = b;
+	stats->residual = 0;
+	stats->correction = 0;
+	stats->max_change = 0;
+}
+
+static void accumulate_stats(edgefixer_edge_stats *stats, double x, double y, double fitted)
+{
+	double change = fitted - x;
+
+	stats->residual += (fitted - y) * (fitted - y);
+	stats->correction += change * change;
+	stats->max_change = MAX(stats->max_change, fabs(change));
+}
+
+static void finish_stats(edgefixer_edge_stats *stats, int n, double sum_x, double sum_y, double sum_xsqr, double sum_ysqr)
+{
+	double var_x = (sum_xsqr - sum_x * sum_x / n) / n;
+	double var_y = (sum_ysqr - sum_y * sum_y / n) / n;
+
+	stats->residual /= n;
+	stats->correction /= n;
+	stats->mean_shift = (sum_x - sum_y) / n;
+	stats->gain = var_y > 0 ? sqrt(MAX(var_x, 0) / var_y) : 1.0;
+}
+
+void edgefixer_measure_edge_b(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	const uint8_t *x = xptr;
+	const uint8_t *y = yptr;
+
+	least_squares_data *buf = (least_squares_data *)tmp;
+	float a, b;
+	double sum_ysqr = 0;
+	int i;
+
+	integrate_b(x, y, x_dist_to_next, y_dist_to_next, n, buf);
+
+	least_squares(n, buf, &a, &b);
+	init_stats(stats, a, b);
+
+	for (i = 0; i < n; ++i) {
+		uint8_t _x = x[i * x_dist_to_next / sizeof(uint8_t)];
+		uint8_t _y = y[i * y_dist_to_next / sizeof(uint8_t)];
+
+		if (radius) {
+			int left = MAX(i - radius, 0);
+			int right = MIN(i + radius, n - 1);
+			least_squares(right - left + 1, buf + left, &a, &b);
+		}
+		accumulate_stats(stats, _x, _y, float_to_u8(_x * a + b));
+		sum_ysqr += (double)_y * _y;
+	}
+	finish_stats(stats, n, (double)buf[n - 1].integral_x, (double)buf[n - 1].integral_y, (double)buf[n - 1].integral_xsqr, sum_ysqr);
+}
+
+void edgefixer_measure_edge_w(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	const uint16_t *x = xptr;
+	const uint16_t *y = yptr;
+
+	least_squares_data64 *buf = (least_squares_data64 *)tmp;
+	double a, b;
+	double sum_ysqr = 0;
+	int i;
+
+	integrate_w(x, y, x_dist_to_next, y_dist_to_next, n, buf);
+
+	least_squares64(n, buf, &a, &b);
+	init_stats(stats, a, b);
+
+	for (i = 0; i < n; ++i) {
+		uint16_t _x = x[i * x_dist_to_next / sizeof(uint16_t)];
+		uint16_t _y = y[i * y_dist_to_next / sizeof(uint16_t)];
+
+		if (radius) {
+			int left = MAX(i - radius, 0);
+			int right = MIN(i + radius, n - 1);
+			least_squares64(right - left + 1, buf + left, &a, &b);
+		}
+		accumulate_stats(stats, _x, _y, double_to_u16(_x * a + b));
+		sum_ysqr += (double)_y * _y;
+	}
+	finish_stats(stats, n, (double)buf[n - 1].integral_x, (double)buf[n - 1].integral_y, (double)buf[n - 1].integral_xsqr, sum_ysqr);
+}
+
+void edgefixer_measure_edge_f(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	const float *x = xptr;
+	const float *y = yptr;
+
+	least_squares_dataf *buf = (least_squares_dataf *)tmp;
+	double a, b;
+	double sum_ysqr = 0;
+	int i;
+
+	integrate_f(x, y, x_dist_to_next, y_dist_to_next, n, buf);
+
+	least_squaresf(n, buf, &a, &b);
+	init_stats(stats, a, b);
+
+	for (i = 0; i < n; ++i) {
+		float _x = x[i * x_dist_to_next / sizeof(float)];
+		float _y = y[i * y_dist_to_next / sizeof(float)];
+
+		if (radius) {
+			int left = MAX(i - radius, 0);
+			int right = MIN(i + radius, n - 1);
+			least_squaresf(right - left + 1, buf + left, &a, &b);
+		}
+		accumulate_stats(stats, _x, _y, (float)(_x * a + b));
+		sum_ysqr += (double)_y * _y;
+	}
+	finish_stats(stats, n, (double)buf[n - 1].integral_x, (double)buf[n - 1].integral_y, (double)buf[n - 1].integral_xsqr, sum_ysqr);
+}
+
+typedef void (*process_edge_func)(void *, const void *, int, int, int, int, void *);
+typedef void (*measure_edge_func)(const void *, const void *, int, int, int, int, void *, edgefixer_edge_stats *);
+typedef int (*sampled_edge_func)(void *, const void *, int, int, int, int, void *, int);
+
+/* Called for each line of a plane in processing order. A nonzero return
+ * stops the walk and is passed back to the caller. */
+typedef int (*line_visitor)(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx);
+
+typedef struct edge_context {
+	edgefixer_type type;
+	int radius;
+	void *tmp;
+	edgefixer_edge_stats *stats;
+	int step;
+} edge_context;
+
+static int sample_size(edgefixer_type type)
+{
+	return type == EDGEFIXER_FLOAT ? 4 : type == EDGEFIXER_WORD ? 2 : 1;
+}
+
+static process_edge_func select_process_edge(edgefixer_type type)
+{
+	return type == EDGEFIXER_FLOAT ? edgefixer_process_edge_f : type == EDGEFIXER_WORD ? edgefixer_process_edge_w : edgefixer_process_edge_b;
+}
+
+static measure_edge_func select_measure_edge(edgefixer_type type)
+{
+	return type == EDGEFIXER_FLOAT ? edgefixer_measure_edge_f : type == EDGEFIXER_WORD ? edgefixer_measure_edge_w : edgefixer_measure_edge_b;
+}
+
+static sampled_edge_func select_sampled_edge(edgefixer_type type)
+{
+	return type == EDGEFIXER_FLOAT ? sampled_edge_f : type == EDGEFIXER_WORD ? sampled_edge_w : sampled_edge_b;
+}
+
+static int visit_continuity_lines(uint8_t *p, int stride, int step, int width, int height, int left, int top, int right, int bottom, line_visitor visit, void *ctx)
+{
+	int i, ret;
+
+	for (i = 0; i < top; ++i) {
+		int ref_row = top - i;
+		if ((ret = visit(p + stride * (ref_row - 1), p + stride * ref_row, step, step, width, top - 1 - i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < bottom; ++i) {
+		int ref_row = height - bottom - 1 + i;
+		if ((ret = visit(p + stride * (ref_row + 1), p + stride * ref_row, step, step, width, top + bottom - 1 - i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < left; ++i) {
+		int ref_col = left - i;
+		if ((ret = visit(p + step * (ref_col - 1), p + step * ref_col, stride, stride, height, top + bottom + left - 1 - i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < right; ++i) {
+		int ref_col = width - right - 1 + i;
+		if ((ret = visit(p + step * (ref_col + 1), p + step * ref_col, stride, stride, height, top + bottom + left + right - 1 - i, ctx)))
+			return ret;
+	}
+	return 0;
+}
+
+static int visit_reference_lines(uint8_t *p, int stride, const uint8_t *ref_p, int ref_stride, int step, int width, int height, int left, int top, int right, int bottom, line_visitor visit, void *ctx)
+{
+	int i, ret;
+
+	for (i = 0; i < top; ++i) {
+		if ((ret = visit(p + stride * i, ref_p + ref_stride * i, step, step, width, i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < bottom; ++i) {
+		if ((ret = visit(p + stride * (height - i - 1), ref_p + ref_stride * (height - i - 1), step, step, width, top + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < left; ++i) {
+		if ((ret = visit(p + step * i, ref_p + step * i, stride, ref_stride, height, top + bottom + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < right; ++i) {
+		if ((ret = visit(p + step * (width - i - 1), ref_p + step * (width - i - 1), stride, ref_stride, height, top + bottom + left + i, ctx)))
+			return ret;
+	}
+	return 0;
+}
+
+static int process_visitor(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx)
+{
+	edge_context *c = ctx;
+	select_process_edge(c->type)(x, y, x_dist_to_next, y_dist_to_next, n, c->radius, c->tmp);
+	return 0;
+}
+
+static int changes_visitor(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx)
+{
+	edge_context *c = ctx;
+	edgefixer_edge_stats stats;
+
+	select_measure_edge(c->type)(x, y, x_dist_to_next, y_dist_to_next, n, c->radius, c->tmp, &stats);
+	return stats.max_change > 0;
+}
+
+static int measure_visitor(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx)
+{
+	edge_context *c = ctx;
+	select_measure_edge(c->type)(x, y, x_dist_to_next, y_dist_to_next, n, c->radius, c->tmp, c->stats + line);
+	return 0;
+}
+
+static int sampled_process_visitor(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx)
+{
+	edge_context *c = ctx;
+	select_sampled_edge(c->type)(x, y, x_dist_to_next, y_dist_to_next, n, c->step, c->tmp, 1);
+	return 0;
+}
+
+static int sampled_changes_visitor(uint8_t *x, const uint8_t *y, int x_dist_to_next, int y_dist_to_next, int n, int line, void *ctx)
+{
+	edge_context *c = ctx;
+	return select_sampled_edge(c->type)(x, y, x_dist_to_next, y_dist_to_next, n, c->step, c->tmp, 0);
+}
+
+size_t edgefixer_required_buffer(edgefixer_type type, int width, int height)
+{
+	int n = MAX(width, height);
+	return type == EDGEFIXER_FLOAT ? edgefixer_required_buffer_f(n) : type == EDGEFIXER_WORD ? edgefixer_required_buffer_w(n) : edgefixer_required_buffer_b(n);
+}
+
+void edgefixer_continuity(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	visit_continuity_lines(ptr, stride, sample_size(type), width, height, left, top, right, bottom, process_visitor, &ctx);
+}
+
+void edgefixer_reference(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	visit_reference_lines(ptr, stride, ref_ptr, ref_stride, sample_size(type), width, height, left, top, right, bottom, process_visitor, &ctx);
+}
+
+/* Each continuity line is fitted against the line processed before it. If
+ * none of the lines change, every fit sees unmodified input, so measuring the
+ * source is exact. */
+int edgefixer_continuity_changes(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	return visit_continuity_lines((uint8_t *)ptr, stride, sample_size(type), width, height, left, top, right, bottom, changes_visitor, &ctx);
+}
+
+int edgefixer_reference_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	return visit_reference_lines((uint8_t *)ptr, stride, ref_ptr, ref_stride, sample_size(type), width, height, left, top, right, bottom, changes_visitor, &ctx);
+}
+
+void edgefixer_continuity_measure(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	edge_context ctx = { type, radius, tmp, stats, 1 };
+	visit_continuity_lines((uint8_t *)ptr, stride, sample_size(type), width, height, left, top, right, bottom, measure_visitor, &ctx);
+}
+
+void edgefixer_reference_measure(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	edge_context ctx = { type, radius, tmp, stats, 1 };
+	visit_reference_lines((uint8_t *)ptr, stride, ref_ptr, ref_stride, sample_size(type), width, height, left, top, right, bottom, measure_visitor, &ctx);
+}
+
+void edgefixer_continuity_sampled(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp)
+{
+	edge_context ctx = { type, 0, tmp, 0, step };
+	visit_continuity_lines(ptr, stride, sample_size(type), width, height, left, top, right, bottom, sampled_process_visitor, &ctx);
+}
+
+void edgefixer_reference_sampled(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp)
+{
+	edge_context ctx = { type, 0, tmp, 0, step };
+	visit_reference_lines(ptr, stride, ref_ptr, ref_stride, sample_size(type), width, height, left, top, right, bottom, sampled_process_visitor, &ctx);
+}
+
+int edgefixer_continuity_sampled_changes(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp)
+{
+	edge_context ctx = { type, 0, tmp, 0, step };
+	return visit_continuity_lines((uint8_t *)ptr, stride, sample_size(type), width, height, left, top, right, bottom, sampled_changes_visitor, &ctx);
+}
+
+int edgefixer_reference_sampled_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp)
+{
+	edge_context ctx = { type, 0, tmp, 0, step };
+	return visit_reference_lines((uint8_t *)ptr, stride, ref_ptr, ref_stride, sample_size(type), width, height, left, top, right, bottom, sampled_changes_visitor, &ctx);
+}
+
+void edgefixer_continuity_interleaved(edgefixer_type type, void *ptr, int stride, int components, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	int size = sample_size(type);
+	int c;
+
+	for (c = 0; c < components; ++c)
+		visit_continuity_lines((uint8_t *)ptr + c * size, stride, size * components, width, height, left, top, right, bottom, process_visitor, &ctx);
+}
+
+void edgefixer_reference_interleaved(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int components, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	int size = sample_size(type);
+	int c;
+
+	for (c = 0; c < components; ++c)
+		visit_reference_lines((uint8_t *)ptr + c * size, stride, (const uint8_t *)ref_ptr + c * size, ref_stride, size * components, width, height, left, top, right, bottom, process_visitor, &ctx);
+}
+
+/* Linear interpolation weights of position i of n when sampled from ref_n
+ * samples with the same extent, clamped to the outermost samples. */
+static void scale_position(int i, int n, int ref_n, int *lo, int *hi, double *w)
+{
+	double pos = (i + 0.5) * ref_n / n - 0.5;
+
+	pos = MIN(MAX(pos, 0), ref_n - 1);
+	*lo = (int)pos;
+	*hi = MIN(*lo + 1, ref_n - 1);
+	*w = pos - *lo;
+}
+
+static double load_sample(edgefixer_type type, const uint8_t *p)
+{
+	return type == EDGEFIXER_FLOAT ? *(const float *)p : type == EDGEFIXER_WORD ? *(const uint16_t *)p : *p;
+}
+
+static void store_sample(edgefixer_type type, uint8_t *p, double v)
+{
+	if (type == EDGEFIXER_FLOAT)
+		*(float *)p = (float)v;
+	else if (type == EDGEFIXER_WORD)
+		*(uint16_t *)p = double_to_u16(v);
+	else
+		*p = float_to_u8((float)v);
+}
+
+/* Write line of lines, each n samples long, bilinearly resampled from a
+ * reference of ref_lines lines of ref_n samples, into buf. */
+static void resample_line(edgefixer_type type, const uint8_t *ref_p, int ref_dist_to_next_line, int ref_dist_to_next, int ref_lines, int ref_n, int line, int lines, int n, void *buf)
+{
+	const uint8_t *ref_lo, *ref_hi;
+	int lo, hi, i;
+	double w;
+
+	scale_position(line, lines, ref_lines, &lo, &hi, &w);
+	ref_lo = ref_p + ref_dist_to_next_line * lo;
+	ref_hi = ref_p + ref_dist_to_next_line * hi;
+
+	for (i = 0; i < n; ++i) {
+		int a, b;
+		double v, u;
+
+		scale_position(i, n, ref_n, &a, &b, &u);
+		v = (1 - w) * ((1 - u) * load_sample(type, ref_lo + ref_dist_to_next * a) + u * load_sample(type, ref_lo + ref_dist_to_next * b)) +
+		    w * ((1 - u) * load_sample(type, ref_hi + ref_dist_to_next * a) + u * load_sample(type, ref_hi + ref_dist_to_next * b));
+
+		store_sample(type, (uint8_t *)buf + sample_size(type) * i, v);
+	}
+}
+
+/* Like visit_reference_lines, but each reference line is resampled into the
+ * start of tmp from a ref_width x ref_height reference covering the plane. */
+static int visit_scaled_reference_lines(edgefixer_type type, uint8_t *p, int stride, const uint8_t *ref_p, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, void *tmp, line_visitor visit, void *ctx)
+{
+	int size = sample_size(type);
+	int i, ret;
+
+	for (i = 0; i < top; ++i) {
+		resample_line(type, ref_p, ref_stride, size, ref_height, ref_width, i, height, width, tmp);
+		if ((ret = visit(p + stride * i, tmp, size, size, width, i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < bottom; ++i) {
+		resample_line(type, ref_p, ref_stride, size, ref_height, ref_width, height - i - 1, height, width, tmp);
+		if ((ret = visit(p + stride * (height - i - 1), tmp, size, size, width, top + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < left; ++i) {
+		resample_line(type, ref_p, size, ref_stride, ref_width, ref_height, i, width, height, tmp);
+		if ((ret = visit(p + size * i, tmp, stride, size, height, top + bottom + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < right; ++i) {
+		resample_line(type, ref_p, size, ref_stride, ref_width, ref_height, width - i - 1, width, height, tmp);
+		if ((ret = visit(p + size * (width - i - 1), tmp, stride, size, height, top + bottom + left + i, ctx)))
+			return ret;
+	}
+	return 0;
+}
+
+/* The resampled line comes first in tmp, padded to keep the fit buffer aligned. */
+static size_t scaled_line_size(edgefixer_type type, int width, int height)
+{
+	return ((size_t)MAX(width, height) * sample_size(type) + 63) & ~(size_t)63;
+}
+
+size_t edgefixer_required_buffer_scaled(edgefixer_type type, int width, int height)
+{
+	return scaled_line_size(type, width, height) + edgefixer_required_buffer(type, width, height);
+}
+
+void edgefixer_reference_scaled(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, (uint8_t *)tmp + scaled_line_size(type, width, height), 0, 1 };
+	visit_scaled_reference_lines(type, ptr, stride, ref_ptr, ref_stride, ref_width, ref_height, width, height, left, top, right, bottom, tmp, process_visitor, &ctx);
+}
+
+int edgefixer_reference_scaled_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, (uint8_t *)tmp + scaled_line_size(type, width, height), 0, 1 };
+	return visit_scaled_reference_lines(type, (uint8_t *)ptr, stride, ref_ptr, ref_stride, ref_width, ref_height, width, height, left, top, right, bottom, tmp, changes_visitor, &ctx);
+}
+
+void edgefixer_reference_scaled_measure(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	edge_context ctx = { type, radius, (uint8_t *)tmp + scaled_line_size(type, width, height), stats, 1 };
+	visit_scaled_reference_lines(type, (uint8_t *)ptr, stride, ref_ptr, ref_stride, ref_width, ref_height, width, height, left, top, right, bottom, tmp, measure_visitor, &ctx);
+}
+
+/* Return nonzero if any of the n samples starting at p exceeds threshold. */
+static int line_above(edgefixer_type type, const uint8_t *p, int dist_to_next, int n, double threshold)
+{
+	int i;
+
+	for (i = 0; i < n; ++i, p += dist_to_next) {
+		if (load_sample(type, p) > threshold)
+			return 1;
+	}
+	return 0;
+}
+
+int edgefixer_detect_active(edgefixer_type type, const void *ptr, int stride, int width, int height, double threshold, int *x, int *y, int *w, int *h)
+{
+	const uint8_t *p = ptr;
+	int size = sample_size(type);
+	int top, bottom, left, right;
+
+	for (top = 0; top < height && !line_above(type, p + stride * top, size, width, threshold); ++top) {}
+	if (top == height)
+		return 0;
+	for (bottom = height - 1; !line_above(type, p + stride * bottom, size, width, threshold); --bottom) {}
+
+	/* Columns are only searched between the bars found above. */
+	p += stride * top;
+	for (left = 0; !line_above(type, p + size * left, stride, bottom - top + 1, threshold); ++left) {}
+	for (right = width - 1; !line_above(type, p + size * right, stride, bottom - top + 1, threshold); --right) {}
+
+	*x = left;
+	*y = top;
+	*w = right - left + 1;
+	*h = bottom - top + 1;
+	return 1;
+}
+
+int edgefixer_strips_width(int width, int height)
+{
+	return MAX(width, height);
+}
+
+/* Copy n samples dist_to_next bytes apart from src into consecutive samples
+ * of dst, repeating the last one up to strip_n samples. */
+static void copy_to_strip(int size, uint8_t *dst, const uint8_t *src, int dist_to_next, int n, int strip_n)
+{
+	int i;
+
+	for (i = 0; i < n; ++i)
+		memcpy(dst + size * i, src + dist_to_next * i, size);
+	for (; i < strip_n; ++i)
+		memcpy(dst + size * i, dst + size * (n - 1), size);
+}
+
+static void copy_from_strip(int size, uint8_t *dst, int dist_to_next, const uint8_t *src, int n)
+{
+	int i;
+
+	for (i = 0; i < n; ++i)
+		memcpy(dst + dist_to_next * i, src + size * i, size);
+}
+
+void edgefixer_extract_strips(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, void *strips, int strips_stride)
+{
+	const uint8_t *p = ptr;
+	uint8_t *s = strips;
+	int size = sample_size(type);
+	int strip_n = edgefixer_strips_width(width, height);
+	int i;
+
+	for (i = 0; i < top; ++i, s += strips_stride)
+		copy_to_strip(size, s, p + stride * i, size, width, strip_n);
+	for (i = 0; i < bottom; ++i, s += strips_stride)
+		copy_to_strip(size, s, p + stride * (height - bottom + i), size, width, strip_n);
+	for (i = 0; i < left; ++i, s += strips_stride)
+		copy_to_strip(size, s, p + size * i, stride, height, strip_n);
+	for (i = 0; i < right; ++i, s += strips_stride)
+		copy_to_strip(size, s, p + size * (width - right + i), stride, height, strip_n);
+}
+
+/* Columns are written last, so they win where the bands overlap at the corners. */
+void edgefixer_insert_strips(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, const void *strips, int strips_stride)
+{
+	uint8_t *p = ptr;
+	const uint8_t *s = strips;
+	int size = sample_size(type);
+	int i;
+
+	for (i = 0; i < top; ++i, s += strips_stride)
+		copy_from_strip(size, p + stride * i, size, s, width);
+	for (i = 0; i < bottom; ++i, s += strips_stride)
+		copy_from_strip(size, p + stride * (height - bottom + i), size, s, width);
+	for (i = 0; i < left; ++i, s += strips_stride)
+		copy_from_strip(size, p + size * i, stride, s, height);
+	for (i = 0; i < right; ++i, s += strips_stride)
+		copy_from_strip(size, p + size * (width - right + i), stride, s, height);
+}
+
+/* Like visit_reference_lines, but the reference lines are read from strips
+ * extracted with the given depths. */
+static int visit_strip_reference_lines(uint8_t *p, int stride, const uint8_t *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int step, int width, int height, int left, int top, int right, int bottom, line_visitor visit, void *ctx)
+{
+	const uint8_t *bottom_strips = strips + strips_stride * strip_top;
+	const uint8_t *left_strips = bottom_strips + strips_stride * strip_bottom;
+	const uint8_t *right_strips = left_strips + strips_stride * strip_left;
+	int i, ret;
+
+	for (i = 0; i < top; ++i) {
+		if ((ret = visit(p + stride * i, strips + strips_stride * i, step, step, width, i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < bottom; ++i) {
+		if ((ret = visit(p + stride * (height - i - 1), bottom_strips + strips_stride * (strip_bottom - i - 1), step, step, width, top + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < left; ++i) {
+		if ((ret = visit(p + step * i, left_strips + strips_stride * i, stride, step, height, top + bottom + i, ctx)))
+			return ret;
+	}
+	for (i = 0; i < right; ++i) {
+		if ((ret = visit(p + step * (width - i - 1), right_strips + strips_stride * (strip_right - i - 1), stride, step, height, top + bottom + left + i, ctx)))
+			return ret;
+	}
+	return 0;
+}
+
+void edgefixer_reference_strips(edgefixer_type type, void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	visit_strip_reference_lines(ptr, stride, strips, strips_stride, strip_left, strip_top, strip_right, strip_bottom, sample_size(type), width, height, left, top, right, bottom, process_visitor, &ctx);
+}
+
+int edgefixer_reference_strips_changes(edgefixer_type type, const void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp)
+{
+	edge_context ctx = { type, radius, tmp, 0, 1 };
+	return visit_strip_reference_lines((uint8_t *)ptr, stride, strips, strips_stride, strip_left, strip_top, strip_right, strip_bottom, sample_size(type), width, height, left, top, right, bottom, changes_visitor, &ctx);
+}
+
+void edgefixer_reference_strips_measure(edgefixer_type type, const void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats)
+{
+	edge_context ctx = { type, radius, tmp, stats, 1 };
+	visit_strip_reference_lines((uint8_t *)ptr, stride, strips, strips_stride, strip_left, strip_top, strip_right, strip_bottom, sample_size(type), width, height, left, top, right, bottom, measure_visitor, &ctx);
+}
+
+/* Write the mean or median over count planes of n samples per line into dst,
+ * padded to strip_n samples. Line k starts at offset[k] from ptrs[k], and its
+ * samples are dist_to_next[k] bytes apart. */
+static void temporal_line(edgefixer_type type, const uint8_t *const *ptrs, const size_t *offset, const int *dist_to_next, int count, int n, int strip_n, int median, uint8_t *dst)
+{
+	double values[EDGEFIXER_TEMPORAL_MAX];
+	int size = sample_size(type);
+	int i, j, k;
+
+	for (i = 0; i < n; ++i) {
+		double v = 0;
+
+		for (k = 0; k < count; ++k) {
+			double x = load_sample(type, ptrs[k] + offset[k] + (size_t)dist_to_next[k] * i);
+
+			/* Insertion sort; count is small. */
+			for (j = k; j > 0 && values[j - 1] > x; --j)
+				values[j] = values[j - 1];
+			values[j] = x;
+			v += x;
+		}
+
+		if (median)
+			v = count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+		else
+			v /= count;
+		store_sample(type, dst + size * i, v);
+	}
+	for (; i < strip_n; ++i)
+		memcpy(dst + size * i, dst + size * (n - 1), size);
+}
+
+void edgefixer_temporal_strips(edgefixer_type type, const void *const *ptrs, const int *strides, int count, int width, int height, int left, int top, int right, int bottom, int median, void *strips, int strips_stride)
+{
+	size_t offset[EDGEFIXER_TEMPORAL_MAX];
+	int dist_to_next[EDGEFIXER_TEMPORAL_MAX];
+	uint8_t *s = strips;
+	int size = sample_size(type);
+	int strip_n = edgefixer_strips_width(width, height);
+	int i, k;
+
+	for (k = 0; k < count; ++k)
+		dist_to_next[k] = size;
+	for (i = 0; i < top + bottom; ++i, s += strips_stride) {
+		int row = i < top ? i : height - bottom + i - top;
+
+		for (k = 0; k < count; ++k)
+			offset[k] = (size_t)strides[k] * row;
+		temporal_line(type, (const uint8_t *const *)ptrs, offset, dist_to_next, count, width, strip_n, median, s);
+	}
+
+	for (k = 0; k < count; ++k)
+		dist_to_next[k] = strides[k];
+	for (i = 0; i < left + right; ++i, s += strips_stride) {
+		int column = i < left ? i : width - right + i - left;
+
+		for (k = 0; k < count; ++k)
+			offset[k] = (size_t)size * column;
+		temporal_line(type, (const uint8_t *const *)ptrs, offset, dist_to_next, count, height, strip_n, median, s);
+	}
+}
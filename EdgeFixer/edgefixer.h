@@ -4,10 +4,125 @@
 #include <stddef.h>
 #include <stdint.h>
 
-size_t edgefixer_required_buffer_b(int n);
-size_t edgefixer_required_buffer_w(int n);
+#ifdef _WIN32
+#define EDGEFIXER_API __declspec(dllexport)
+#else
+#define EDGEFIXER_API
+#endif
 
-void edgefixer_process_edge_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp);
-void edgefixer_process_edge_w(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp);
+typedef enum edgefixer_type {
+	EDGEFIXER_BYTE,
+	EDGEFIXER_WORD,
+	EDGEFIXER_FLOAT
+} edgefixer_type;
+
+/* Fit of a single line, as computed by the edgefixer_measure_edge_* family.
+ * Residual and correction are mean squared values in sample units. */
+typedef struct edgefixer_edge_stats {
+	double slope;      /* a of the fit over the whole line */
+	double offset;     /* b of the fit over the whole line */
+	double residual;   /* corrected line against the reference */
+	double correction; /* corrected line against the original line */
+	double max_change; /* largest absolute change to any sample */
+	double mean_shift; /* mean of the line minus mean of the reference */
+	double gain;       /* standard deviation of the line over that of the reference */
+} edgefixer_edge_stats;
+
+EDGEFIXER_API size_t edgefixer_required_buffer_b(int n);
+EDGEFIXER_API size_t edgefixer_required_buffer_w(int n);
+EDGEFIXER_API size_t edgefixer_required_buffer_f(int n);
+
+EDGEFIXER_API void edgefixer_process_edge_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_process_edge_w(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_process_edge_f(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp);
+
+/* Compute the fit and its effect without writing to xptr. */
+EDGEFIXER_API void edgefixer_measure_edge_b(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats);
+EDGEFIXER_API void edgefixer_measure_edge_w(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats);
+EDGEFIXER_API void edgefixer_measure_edge_f(const void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int radius, void *tmp, edgefixer_edge_stats *stats);
+
+/* Plane-level entry points. The edge counts apply to the outermost lines of
+ * a width x height plane addressed by ptr and stride (in bytes). tmp must hold
+ * at least edgefixer_required_buffer(type, width, height) bytes. */
+EDGEFIXER_API size_t edgefixer_required_buffer(edgefixer_type type, int width, int height);
+
+EDGEFIXER_API void edgefixer_continuity(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_reference(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+
+/* Return nonzero if the corresponding call above would modify any sample.
+ * The plane is only read, so callers can skip making it writable. */
+EDGEFIXER_API int edgefixer_continuity_changes(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API int edgefixer_reference_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+
+/* Measure every line the corresponding call above would process, without
+ * writing. stats receives top + bottom + left + right entries: the top lines,
+ * then bottom, left and right, each ordered from the border inwards. Each
+ * continuity line is measured against its unprocessed neighbor. */
+EDGEFIXER_API void edgefixer_continuity_measure(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats);
+EDGEFIXER_API void edgefixer_reference_measure(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats);
+
+/* Approximate radius 0 processing: a and b are fitted from every step-th
+ * sample of each line, and every sample is corrected. Lines too short for 16
+ * samples at that step use a smaller one. */
+EDGEFIXER_API void edgefixer_process_edge_sampled_b(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp);
+EDGEFIXER_API void edgefixer_process_edge_sampled_w(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp);
+EDGEFIXER_API void edgefixer_process_edge_sampled_f(void *xptr, const void *yptr, int x_dist_to_next, int y_dist_to_next, int n, int step, void *tmp);
+
+EDGEFIXER_API void edgefixer_continuity_sampled(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp);
+EDGEFIXER_API void edgefixer_reference_sampled(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp);
+EDGEFIXER_API int edgefixer_continuity_sampled_changes(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp);
+EDGEFIXER_API int edgefixer_reference_sampled_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int width, int height, int left, int top, int right, int bottom, int step, void *tmp);
+
+/* Semi-planar planes, such as the UV plane of NV12, P010 or P016, hold
+ * components samples per pixel. Each component is fixed separately with the
+ * same edge counts; width is in pixels, not samples. The luma plane of such a
+ * format is an ordinary plane. */
+EDGEFIXER_API void edgefixer_continuity_interleaved(edgefixer_type type, void *ptr, int stride, int components, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_reference_interleaved(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int components, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+
+/* Reference processing with a reference plane of ref_width x ref_height
+ * covering the same picture as the width x height plane at a lower (or
+ * higher) resolution. Each reference line is bilinearly resampled at the
+ * position of the line it is fitted against. tmp must hold at least
+ * edgefixer_required_buffer_scaled(type, width, height) bytes. */
+EDGEFIXER_API size_t edgefixer_required_buffer_scaled(edgefixer_type type, int width, int height);
+
+EDGEFIXER_API void edgefixer_reference_scaled(edgefixer_type type, void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API int edgefixer_reference_scaled_changes(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_reference_scaled_measure(edgefixer_type type, const void *ptr, int stride, const void *ref_ptr, int ref_stride, int ref_width, int ref_height, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats);
+
+/* Find the active picture of a letterboxed or pillarboxed plane: the smallest
+ * rectangle outside of which no sample exceeds threshold, such as the black
+ * level plus some noise margin. Only the bars and the first picture line past
+ * each are read. Returns 0 if no sample exceeds threshold. Passing the
+ * rectangle's corner as ptr and its size to the calls above fixes the edges
+ * of the picture rather than of the plane. */
+EDGEFIXER_API int edgefixer_detect_active(edgefixer_type type, const void *ptr, int stride, int width, int height, double threshold, int *x, int *y, int *w, int *h);
+
+/* Border strips pack the outermost lines of a plane into a plane of
+ * edgefixer_strips_width(width, height) samples by left + top + right + bottom
+ * lines, so that other filters can process the borders alone: the top and
+ * bottom bands in plane order, then the left and right bands with each column
+ * transposed into a line. Lines shorter than the strips are padded by
+ * repeating their last sample. */
+EDGEFIXER_API int edgefixer_strips_width(int width, int height);
+EDGEFIXER_API void edgefixer_extract_strips(edgefixer_type type, const void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, void *strips, int strips_stride);
+EDGEFIXER_API void edgefixer_insert_strips(edgefixer_type type, void *ptr, int stride, int width, int height, int left, int top, int right, int bottom, const void *strips, int strips_stride);
+
+/* Reference processing with the reference lines read from strips extracted
+ * with depths strip_left, strip_top, strip_right and strip_bottom, which must
+ * be at least left, top, right and bottom. */
+EDGEFIXER_API void edgefixer_reference_strips(edgefixer_type type, void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API int edgefixer_reference_strips_changes(edgefixer_type type, const void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp);
+EDGEFIXER_API void edgefixer_reference_strips_measure(edgefixer_type type, const void *ptr, int stride, const void *strips, int strips_stride, int strip_left, int strip_top, int strip_right, int strip_bottom, int width, int height, int left, int top, int right, int bottom, int radius, void *tmp, edgefixer_edge_stats *stats);
+
+/* Build strips, laid out as by edgefixer_extract_strips, holding the mean
+ * or, if median is set, the median of each border sample over count planes
+ * of the same size, such as the neighbors of a frame, as a temporally
+ * smoothed reference for edgefixer_reference_strips. Only the border lines
+ * are read. count must be between 1 and EDGEFIXER_TEMPORAL_MAX. */
+#define EDGEFIXER_TEMPORAL_MAX 31
+
+EDGEFIXER_API void edgefixer_temporal_strips(edgefixer_type type, const void *const *ptrs, const int *strides, int count, int width, int height, int left, int top, int right, int bottom, int median, void *strips, int strips_stride);
 
 #endif /* EDGEFIXER_H */
@@ -1,7 +1,21 @@
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
 #include "edgefixer.h"
 #include "VapourSynth.h"
 #include "VSHelper.h"
 
+/* Edges and radius for the frames first to last. */
+typedef struct vs_edgefix_zone {
+	int first;
+	int last;
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int radius;
+} vs_edgefix_zone;
+
 typedef struct vs_edgefix_data {
 	VSNodeRef *node;
 	VSNodeRef *ref_node;
@@ -11,8 +25,408 @@ typedef struct vs_edgefix_data {
 	int right;
 	int bottom;
 	int radius;
+	int first;
+	int last;
+	int passthrough;
+	int measure;
+	int fields;
+	int sample;
+	int num_planes;
+	int crop_left;
+	int crop_top;
+	int crop_right;
+	int crop_bottom;
+	int active_x;
+	int active_y;
+	int active_width;
+	int active_height;
+	int detect;
+	vs_edgefix_zone *zones;
+	int num_zones;
+	int frame_props;
+	int ref_scale_x;
+	int ref_scale_y;
+	int strips;
+	int strip_left;
+	int strip_top;
+	int strip_right;
+	int strip_bottom;
+	int temporal;
+	int temporal_median;
 } vs_edgefix_data;
 
+/* Region of the output whose edges are fixed. */
+typedef struct vs_edgefix_rect {
+	int x;
+	int y;
+	int width;
+	int height;
+} vs_edgefix_rect;
+
+static int vs_edgefix_in_range(const vs_edgefix_data *data, int n)
+{
+	return n >= data->first && n <= data->last;
+}
+
+static int vs_edgefix_num_lines(const vs_edgefix_data *data)
+{
+	return data->top + data->bottom + data->left + data->right;
+}
+
+static int vs_edgefix_ref_scaled(const vs_edgefix_data *data)
+{
+	return data->ref_scale_x > 1 || data->ref_scale_y > 1;
+}
+
+/* Frames first to last around n make up a temporal reference, read from the
+ * reference clip if there is one, or else from the clip itself. */
+static void vs_edgefix_temporal_range(const vs_edgefix_data *data, int n, int *first, int *last)
+{
+	*first = VSMAX(n - data->temporal, 0);
+	*last = data->vi.numFrames ? VSMIN(n + data->temporal, data->vi.numFrames - 1) : n + data->temporal;
+}
+
+static VSNodeRef *vs_edgefix_temporal_node(const vs_edgefix_data *data)
+{
+	return data->ref_node ? data->ref_node : data->node;
+}
+
+static int vs_edgefix_cropping(const vs_edgefix_data *data)
+{
+	return !!(data->crop_left | data->crop_top | data->crop_right | data->crop_bottom);
+}
+
+/* Check the edges and radius of data against its active region. Returns an
+ * error message, or 0 if they are usable. */
+static const char *vs_edgefix_check_edges(const vs_edgefix_data *data)
+{
+	if (data->left < 0 || data->right < 0 || data->top < 0 || data->bottom < 0)
+		return "too few edges to fix";
+	if (data->left > data->active_width || data->right > data->active_width || data->top > data->active_height / data->fields || data->bottom > data->active_height / data->fields)
+		return "too many edges to fix";
+	if (data->sample > 1 && data->radius)
+		return "sample requires radius 0";
+	if (data->strips && (data->left > data->strip_left || data->top > data->strip_top || data->right > data->strip_right || data->bottom > data->strip_bottom))
+		return "edges must lie within the reference strips";
+	return 0;
+}
+
+static void vs_edgefix_apply_zone(vs_edgefix_data *data, const vs_edgefix_zone *zone)
+{
+	data->left = zone->left;
+	data->top = zone->top;
+	data->right = zone->right;
+	data->bottom = zone->bottom;
+	data->radius = zone->radius;
+}
+
+static void vs_edgefix_get_prop(const VSMap *props, const char *key, int *value, const VSAPI *vsapi)
+{
+	int err;
+	int prop = (int)vsapi->propGetInt(props, key, 0, &err);
+	if (!err)
+		*value = prop;
+}
+
+/* Replace the edges and radius of data with those of the first zone holding
+ * frame n, then with any the frame carries as properties. Returns an error
+ * message, or 0 if the result is usable. */
+static const char *vs_edgefix_frame_edges(vs_edgefix_data *data, int n, const VSFrameRef *frame, const VSAPI *vsapi)
+{
+	int i;
+
+	for (i = 0; i < data->num_zones; ++i) {
+		const vs_edgefix_zone *zone = data->zones + i;
+
+		if (n >= zone->first && n <= zone->last) {
+			vs_edgefix_apply_zone(data, zone);
+			break;
+		}
+	}
+
+	if (data->frame_props) {
+		const VSMap *props = vsapi->getFramePropsRO(frame);
+
+		vs_edgefix_get_prop(props, "EdgeFixerLeft", &data->left, vsapi);
+		vs_edgefix_get_prop(props, "EdgeFixerTop", &data->top, vsapi);
+		vs_edgefix_get_prop(props, "EdgeFixerRight", &data->right, vsapi);
+		vs_edgefix_get_prop(props, "EdgeFixerBottom", &data->bottom, vsapi);
+		vs_edgefix_get_prop(props, "EdgeFixerRadius", &data->radius, vsapi);
+	}
+
+	return vs_edgefix_check_edges(data);
+}
+
+/* Copy the output region of every plane into a new frame of the output size. */
+static VSFrameRef *vs_edgefix_crop(const VSFrameRef *src_frame, const vs_edgefix_data *data, VSCore *core, const VSAPI *vsapi)
+{
+	const VSFormat *format = vsapi->getFrameFormat(src_frame);
+	VSFrameRef *dst_frame = vsapi->newVideoFrame(format, data->vi.width, data->vi.height, src_frame, core);
+	int plane;
+
+	for (plane = 0; plane < format->numPlanes; ++plane) {
+		int ssw = plane ? format->subSamplingW : 0;
+		int ssh = plane ? format->subSamplingH : 0;
+		int src_stride = vsapi->getStride(src_frame, plane);
+		const uint8_t *src_ptr = vsapi->getReadPtr(src_frame, plane) + (data->crop_top >> ssh) * src_stride + (data->crop_left >> ssw) * format->bytesPerSample;
+
+		vs_bitblt(vsapi->getWritePtr(dst_frame, plane), vsapi->getStride(dst_frame, plane), src_ptr, src_stride,
+		          vsapi->getFrameWidth(dst_frame, plane) * format->bytesPerSample, vsapi->getFrameHeight(dst_frame, plane));
+	}
+
+	return dst_frame;
+}
+
+/* Height of field f when the plane is split into fields by doubling the stride. */
+static int vs_edgefix_field_height(int height, int fields, int f)
+{
+	return (height + fields - 1 - f) / fields;
+}
+
+/* Fix, or check for changes to, every field of a plane, using the approximate
+ * fit when sample is set. */
+static void vs_continuity_plane(const vs_edgefix_data *data, edgefixer_type type, uint8_t *ptr, int stride, int width, int height, void *tmp)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f) {
+		uint8_t *field = ptr + f * stride;
+		int field_height = vs_edgefix_field_height(height, data->fields, f);
+
+		if (data->sample > 1)
+			edgefixer_continuity_sampled(type, field, stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->sample, tmp);
+		else
+			edgefixer_continuity(type, field, stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+	}
+}
+
+static int vs_continuity_plane_changes(const vs_edgefix_data *data, edgefixer_type type, const uint8_t *ptr, int stride, int width, int height, void *tmp)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f) {
+		const uint8_t *field = ptr + f * stride;
+		int field_height = vs_edgefix_field_height(height, data->fields, f);
+		int changes;
+
+		if (data->sample > 1)
+			changes = edgefixer_continuity_sampled_changes(type, field, stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->sample, tmp);
+		else
+			changes = edgefixer_continuity_changes(type, field, stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		if (changes)
+			return 1;
+	}
+	return 0;
+}
+
+/* The reference region is width x height divided by the reference scale, or
+ * strips of the whole frame, which rule out fields. */
+static void vs_reference_plane(const vs_edgefix_data *data, edgefixer_type type, uint8_t *ptr, int stride, const uint8_t *ref_ptr, int ref_stride, int width, int height, void *tmp)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f) {
+		uint8_t *field = ptr + f * stride;
+		const uint8_t *ref_field = ref_ptr + f * ref_stride;
+		int field_height = vs_edgefix_field_height(height, data->fields, f);
+
+		if (data->strips)
+			edgefixer_reference_strips(type, field, stride, ref_field, ref_stride, data->strip_left, data->strip_top, data->strip_right, data->strip_bottom,
+			                           width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		else if (vs_edgefix_ref_scaled(data))
+			edgefixer_reference_scaled(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width / data->ref_scale_x, vs_edgefix_field_height(height / data->ref_scale_y, data->fields, f),
+			                           width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		else if (data->sample > 1)
+			edgefixer_reference_sampled(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->sample, tmp);
+		else
+			edgefixer_reference(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+	}
+}
+
+static int vs_reference_plane_changes(const vs_edgefix_data *data, edgefixer_type type, const uint8_t *ptr, int stride, const uint8_t *ref_ptr, int ref_stride, int width, int height, void *tmp)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f) {
+		const uint8_t *field = ptr + f * stride;
+		const uint8_t *ref_field = ref_ptr + f * ref_stride;
+		int field_height = vs_edgefix_field_height(height, data->fields, f);
+		int changes;
+
+		if (data->strips)
+			changes = edgefixer_reference_strips_changes(type, field, stride, ref_field, ref_stride, data->strip_left, data->strip_top, data->strip_right, data->strip_bottom,
+			                                             width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		else if (vs_edgefix_ref_scaled(data))
+			changes = edgefixer_reference_scaled_changes(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width / data->ref_scale_x, vs_edgefix_field_height(height / data->ref_scale_y, data->fields, f),
+			                                             width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		else if (data->sample > 1)
+			changes = edgefixer_reference_sampled_changes(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->sample, tmp);
+		else
+			changes = edgefixer_reference_changes(type, field, stride * data->fields, ref_field, ref_stride * data->fields, width, field_height, data->left, data->top, data->right, data->bottom, data->radius, tmp);
+		if (changes)
+			return 1;
+	}
+	return 0;
+}
+
+static void vs_continuity_plane_measure(const vs_edgefix_data *data, edgefixer_type type, const uint8_t *ptr, int stride, int width, int height, void *tmp, edgefixer_edge_stats *stats)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f)
+		edgefixer_continuity_measure(type, ptr + f * stride, stride * data->fields, width, vs_edgefix_field_height(height, data->fields, f), data->left, data->top, data->right, data->bottom, data->radius, tmp, stats + f * vs_edgefix_num_lines(data));
+}
+
+static void vs_reference_plane_measure(const vs_edgefix_data *data, edgefixer_type type, const uint8_t *ptr, int stride, const uint8_t *ref_ptr, int ref_stride, int width, int height, void *tmp, edgefixer_edge_stats *stats)
+{
+	int f;
+
+	for (f = 0; f < data->fields; ++f) {
+		if (data->strips)
+			edgefixer_reference_strips_measure(type, ptr, stride, ref_ptr, ref_stride, data->strip_left, data->strip_top, data->strip_right, data->strip_bottom,
+			                                   width, height, data->left, data->top, data->right, data->bottom, data->radius, tmp, stats);
+		else if (vs_edgefix_ref_scaled(data))
+			edgefixer_reference_scaled_measure(type, ptr + f * stride, stride * data->fields, ref_ptr + f * ref_stride, ref_stride * data->fields, width / data->ref_scale_x, vs_edgefix_field_height(height / data->ref_scale_y, data->fields, f),
+			                                   width, vs_edgefix_field_height(height, data->fields, f), data->left, data->top, data->right, data->bottom, data->radius, tmp, stats + f * vs_edgefix_num_lines(data));
+		else
+			edgefixer_reference_measure(type, ptr + f * stride, stride * data->fields, ref_ptr + f * ref_stride, ref_stride * data->fields, width, vs_edgefix_field_height(height, data->fields, f), data->left, data->top, data->right, data->bottom, data->radius, tmp, stats + f * vs_edgefix_num_lines(data));
+	}
+}
+
+/* Start of the active region of a source plane, within the output region. */
+static const uint8_t *vs_edgefix_read_ptr(const VSFrameRef *frame, int plane, const vs_edgefix_data *data, const vs_edgefix_rect *rect, const VSAPI *vsapi)
+{
+	return vsapi->getReadPtr(frame, plane) + (data->crop_top + rect->y) * vsapi->getStride(frame, plane) + (data->crop_left + rect->x) * data->vi.format->bytesPerSample;
+}
+
+/* Start of the active region of a reference plane, which may be scaled down. */
+static const uint8_t *vs_edgefix_ref_ptr(const VSFrameRef *frame, int plane, const vs_edgefix_data *data, const vs_edgefix_rect *rect, const VSAPI *vsapi)
+{
+	return vsapi->getReadPtr(frame, plane) + (data->crop_top + rect->y) / data->ref_scale_y * vsapi->getStride(frame, plane) + (data->crop_left + rect->x) / data->ref_scale_x * data->vi.format->bytesPerSample;
+}
+
+/* Start of the active region of an output plane. */
+static uint8_t *vs_edgefix_write_ptr(VSFrameRef *frame, int plane, const vs_edgefix_data *data, const vs_edgefix_rect *rect, const VSAPI *vsapi)
+{
+	return vsapi->getWritePtr(frame, plane) + rect->y * vsapi->getStride(frame, plane) + rect->x * data->vi.format->bytesPerSample;
+}
+
+/* Find the region to fix in a source frame. With detect, this is the picture
+ * inside the black bars of the given active region, over all processed planes,
+ * starting on a top field line and a whole line of a scaled reference. Returns 0 if no picture is found or it is too
+ * small for the edge counts. */
+static int vs_edgefix_active(const VSFrameRef *src_frame, const vs_edgefix_data *data, const VSAPI *vsapi, vs_edgefix_rect *rect)
+{
+	edgefixer_type type = data->vi.format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+	int left = INT_MAX, top = INT_MAX, right = -1, bottom = -1;
+	int p;
+
+	rect->x = data->active_x;
+	rect->y = data->active_y;
+	rect->width = data->active_width;
+	rect->height = data->active_height;
+	if (data->detect < 0)
+		return 1;
+
+	for (p = 0; p < data->num_planes; ++p) {
+		int x, y, w, h;
+
+		if (edgefixer_detect_active(type, vs_edgefix_read_ptr(src_frame, p, data, rect, vsapi), vsapi->getStride(src_frame, p), rect->width, rect->height, data->detect, &x, &y, &w, &h)) {
+			left = VSMIN(left, x);
+			top = VSMIN(top, y);
+			right = VSMAX(right, x + w);
+			bottom = VSMAX(bottom, y + h);
+		}
+	}
+	if (right < 0)
+		return 0;
+
+	/* Keep the region on whole reference samples and lines. */
+	left -= left % data->ref_scale_x;
+	top -= top % (data->fields * data->ref_scale_y);
+	right = VSMIN(rect->width, (right + data->ref_scale_x - 1) / data->ref_scale_x * data->ref_scale_x);
+	bottom = VSMIN(rect->height, (bottom + data->ref_scale_y - 1) / data->ref_scale_y * data->ref_scale_y);
+	rect->x += left;
+	rect->y += top;
+	rect->width = right - left;
+	rect->height = bottom - top;
+
+	return data->left <= rect->width && data->right <= rect->width && data->top <= rect->height / data->fields && data->bottom <= rect->height / data->fields;
+}
+
+/* Attach the fit of each line, in the order produced by edgefixer_*_measure.
+ * With fields, stats holds that order once per field, and each property lists
+ * the lines of the top field followed by those of the bottom field. RGB
+ * planes follow each other in stats, and their properties carry a plane
+ * prefix. With detect, the detected region is attached too. */
+static void vs_edgefix_set_props(VSMap *props, const edgefixer_edge_stats *stats, const vs_edgefix_data *data, const vs_edgefix_rect *rect, const VSAPI *vsapi)
+{
+	static const char *const edge_names[4] = { "Top", "Bottom", "Left", "Right" };
+	static const char *const plane_names[3] = { "R", "G", "B" };
+	int num_lines = vs_edgefix_num_lines(data);
+	int counts[4];
+	int worst_edge = -1;
+	int worst_plane = 0;
+	int worst_line = 0;
+	double worst_change = -1;
+	int p, edge, f, i;
+
+	counts[0] = data->top;
+	counts[1] = data->bottom;
+	counts[2] = data->left;
+	counts[3] = data->right;
+
+	for (p = 0; p < data->num_planes; ++p) {
+		const char *prefix = data->num_planes > 1 ? plane_names[p] : "";
+		const edgefixer_edge_stats *plane_stats = stats + p * data->fields * num_lines;
+
+		for (edge = 0; edge < 4; ++edge) {
+			char slope_key[48], offset_key[48], residual_key[48];
+
+			snprintf(slope_key, sizeof(slope_key), "EdgeFixer%s%sSlopeDeviation", prefix, edge_names[edge]);
+			snprintf(offset_key, sizeof(offset_key), "EdgeFixer%s%sOffset", prefix, edge_names[edge]);
+			snprintf(residual_key, sizeof(residual_key), "EdgeFixer%s%sResidual", prefix, edge_names[edge]);
+
+			for (f = 0; f < data->fields; ++f) {
+				const edgefixer_edge_stats *s = plane_stats + f * num_lines;
+
+				for (i = 0; i < counts[edge]; ++i) {
+					int append = f || i ? paAppend : paReplace;
+					double change = sqrt(s[i].correction);
+
+					vsapi->propSetFloat(props, slope_key, s[i].slope - 1.0, append);
+					vsapi->propSetFloat(props, offset_key, s[i].offset, append);
+					vsapi->propSetFloat(props, residual_key, s[i].residual, append);
+
+					if (change > worst_change) {
+						worst_edge = edge;
+						worst_plane = p;
+						worst_line = f * counts[edge] + i;
+						worst_change = change;
+					}
+				}
+			}
+			plane_stats += counts[edge];
+		}
+	}
+
+	if (worst_edge >= 0) {
+		char worst_name[8];
+
+		snprintf(worst_name, sizeof(worst_name), "%s%s", data->num_planes > 1 ? plane_names[worst_plane] : "", edge_names[worst_edge]);
+		vsapi->propSetData(props, "EdgeFixerWorstEdge", worst_name, -1, paReplace);
+		vsapi->propSetInt(props, "EdgeFixerWorstLine", worst_line, paReplace);
+		vsapi->propSetFloat(props, "EdgeFixerWorstChange", worst_change, paReplace);
+	}
+
+	if (data->detect >= 0) {
+		vsapi->propSetInt(props, "EdgeFixerActive", rect->x, paReplace);
+		vsapi->propSetInt(props, "EdgeFixerActive", rect->y, paAppend);
+		vsapi->propSetInt(props, "EdgeFixerActive", rect->width, paAppend);
+		vsapi->propSetInt(props, "EdgeFixerActive", rect->height, paAppend);
+	}
+}
+
 static void VS_CC vs_edgefix_init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi)
 {
 	const vs_edgefix_data *data = *instanceData;
@@ -22,57 +436,98 @@ static void VS_CC vs_edgefix_init(VSMap *in, VSMap *out, void **instanceData, VS
 static const VSFrameRef * VS_CC vs_continuity_get_frame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
 {
 	vs_edgefix_data *data = *instanceData;
-	VSFrameRef *ret = 0;
-	int i;
+	const VSFrameRef *ret = 0;
 
 	if (activationReason == arInitial) {
 		vsapi->requestFrameFilter(n, data->node, frameCtx);
 	} else if (activationReason == arAllFramesReady) {
-		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, data->node, frameCtx);
+		/* This frame's edges, which zones and frame properties may override. */
+		vs_edgefix_data params = *data;
+		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, params.node, frameCtx);
 		const VSFrameRef *src_planes[3] = { src_frame, src_frame, src_frame };
 		const VSFormat *format = vsapi->getFrameFormat(src_frame);
 		int plane_order[3] = { 0, 1, 2 };
 
-		int width = vsapi->getFrameWidth(src_frame, 0);
-		int height = vsapi->getFrameHeight(src_frame, 0);
+		/* Output dimensions; edges are fixed relative to the cropped border. */
+		int width = vsapi->getFrameWidth(src_frame, 0) - params.crop_left - params.crop_right;
+		int height = vsapi->getFrameHeight(src_frame, 0) - params.crop_top - params.crop_bottom;
 
-		size_t (*required_buffer)(int) = format->bytesPerSample == 2 ? edgefixer_required_buffer_w : edgefixer_required_buffer_b;
-		void (*process_edge)(void *, const void *, int, int, int, int, void *) = format->bytesPerSample == 2 ? edgefixer_process_edge_w : edgefixer_process_edge_b;
+		edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+		int plane_lines;
 
-		VSFrameRef *dst_frame = vsapi->newVideoFrame2(format, width, height, src_planes, plane_order, src_frame, core);
-		uint8_t *ptr = vsapi->getWritePtr(dst_frame, 0);
-		int stride = vsapi->getStride(dst_frame, 0);
-		int step = format->bytesPerSample;
+		VSFrameRef *dst_frame = 0;
+		void *tmp = 0;
+		edgefixer_edge_stats *stats = 0;
+		vs_edgefix_rect rect;
+		const char *error;
+		int p;
 
-		void *tmp = malloc(required_buffer(width > height ? width : height));
-		if (!tmp) {
-			vsapi->setFilterError("error allocating buffer", frameCtx);
+		if (vs_edgefix_in_range(&params, n) && (error = vs_edgefix_frame_edges(&params, n, src_frame, vsapi))) {
+			vsapi->setFilterError(error, frameCtx);
 			goto fail;
 		}
+		plane_lines = params.fields * vs_edgefix_num_lines(&params);
 
-		for (i = 0; i < data->top; ++i) {
-			int ref_row = data->top - i;
-			process_edge(ptr + stride * (ref_row - 1), ptr + stride * ref_row, step, step, width, data->radius, tmp);
+		if (!vs_edgefix_in_range(&params, n) || !vs_edgefix_num_lines(&params) || !vs_edgefix_active(src_frame, &params, vsapi, &rect)) {
+			if (!vs_edgefix_cropping(&params))
+				return src_frame;
+			ret = vs_edgefix_crop(src_frame, &params, core, vsapi);
+			goto fail;
 		}
-		for (i = 0; i < data->bottom; ++i) {
-			int ref_row = height - data->bottom - 1 + i;
-			process_edge(ptr + stride * (ref_row + 1), ptr + stride * ref_row, step, step, width, data->radius, tmp);
+
+		tmp = malloc(edgefixer_required_buffer(type, width, height));
+		if (!tmp) {
+			vsapi->setFilterError("error allocating buffer", frameCtx);
+			goto fail;
 		}
-		for (i = 0; i < data->left; ++i) {
-			int ref_col = data->left - i;
-			process_edge(ptr + step * (ref_col - 1), ptr + step * ref_col, stride, stride, height, data->radius, tmp);
+
+		if (params.measure) {
+			stats = malloc(params.num_planes * plane_lines * sizeof(edgefixer_edge_stats));
+			if (!stats) {
+				vsapi->setFilterError("error allocating buffer", frameCtx);
+				goto fail;
+			}
+
+			for (p = 0; p < params.num_planes; ++p)
+				vs_continuity_plane_measure(&params, type, vs_edgefix_read_ptr(src_frame, p, &params, &rect, vsapi), vsapi->getStride(src_frame, p), rect.width, rect.height, tmp, stats + p * plane_lines);
+
+			/* Shares the source planes unless cropping; only the properties are new. */
+			dst_frame = vs_edgefix_cropping(&params) ? vs_edgefix_crop(src_frame, &params, core, vsapi) : vsapi->copyFrame(src_frame, core);
+			vs_edgefix_set_props(vsapi->getFramePropsRW(dst_frame), stats, &params, &rect, vsapi);
+			ret = dst_frame;
+			dst_frame = 0;
+			goto fail;
 		}
-		for (i = 0; i < data->right; ++i) {
-			int ref_col = width - data->right - 1 + i;
-			process_edge(ptr + step * (ref_col + 1), ptr + step * ref_col, stride, stride, height, data->radius, tmp);
+
+		/* A cropped frame is a new frame either way, so only skip the copy when not cropping. */
+		if (params.passthrough && !vs_edgefix_cropping(&params)) {
+			int changes = 0;
+
+			for (p = 0; p < params.num_planes && !changes; ++p)
+				changes = vs_continuity_plane_changes(&params, type, vs_edgefix_read_ptr(src_frame, p, &params, &rect, vsapi), vsapi->getStride(src_frame, p), rect.width, rect.height, tmp);
+
+			if (!changes) {
+				ret = src_frame;
+				src_frame = 0;
+				goto fail;
+			}
 		}
 
+		if (vs_edgefix_cropping(&params))
+			dst_frame = vs_edgefix_crop(src_frame, &params, core, vsapi);
+		else
+			dst_frame = vsapi->newVideoFrame2(format, width, height, src_planes, plane_order, src_frame, core);
+
+		for (p = 0; p < params.num_planes; ++p)
+			vs_continuity_plane(&params, type, vs_edgefix_write_ptr(dst_frame, p, &params, &rect, vsapi), vsapi->getStride(dst_frame, p), rect.width, rect.height, tmp);
+
 		ret = dst_frame;
 		dst_frame = 0;
 	fail:
 		vsapi->freeFrame(src_frame);
 		vsapi->freeFrame(dst_frame);
 		free(tmp);
+		free(stats);
 	}
 
 	return ret;
@@ -81,59 +536,156 @@ static const VSFrameRef * VS_CC vs_continuity_get_frame(int n, int activationRea
 static const VSFrameRef * VS_CC vs_reference_get_frame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
 {
 	vs_edgefix_data *data = *instanceData;
-	VSFrameRef *ret = 0;
-	int i;
+	const VSFrameRef *ret = 0;
 
 	if (activationReason == arInitial) {
 		vsapi->requestFrameFilter(n, data->node, frameCtx);
-		vsapi->requestFrameFilter(n, data->ref_node, frameCtx);
+		if (vs_edgefix_in_range(data, n) && data->temporal) {
+			int first, last, i;
+
+			vs_edgefix_temporal_range(data, n, &first, &last);
+			for (i = first; i <= last; ++i)
+				vsapi->requestFrameFilter(i, vs_edgefix_temporal_node(data), frameCtx);
+		} else if (vs_edgefix_in_range(data, n)) {
+			vsapi->requestFrameFilter(n, data->ref_node, frameCtx);
+		}
 	} else if (activationReason == arAllFramesReady) {
-		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, data->node, frameCtx);
+		/* This frame's edges, which zones and frame properties may override. */
+		vs_edgefix_data params = *data;
+		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, params.node, frameCtx);
 		const VSFrameRef *src_planes[3] = { src_frame, src_frame, src_frame };
 		const VSFormat *format = vsapi->getFrameFormat(src_frame);
 		int plane_order[3] = { 0, 1, 2 };
 
-		int width = vsapi->getFrameWidth(src_frame, 0);
-		int height = vsapi->getFrameHeight(src_frame, 0);
+		/* Output dimensions; edges are fixed relative to the cropped border. */
+		int width = vsapi->getFrameWidth(src_frame, 0) - params.crop_left - params.crop_right;
+		int height = vsapi->getFrameHeight(src_frame, 0) - params.crop_top - params.crop_bottom;
 
-		size_t (*required_buffer)(int) = format->bytesPerSample == 2 ? edgefixer_required_buffer_w : edgefixer_required_buffer_b;
-		void (*process_edge)(void *, const void *, int, int, int, int, void *) = format->bytesPerSample == 2 ? edgefixer_process_edge_w : edgefixer_process_edge_b;
+		edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+		int plane_lines;
 
-		VSFrameRef *dst_frame = vsapi->newVideoFrame2(format, width, height, src_planes, plane_order, src_frame, core);
-		uint8_t *ptr = vsapi->getWritePtr(dst_frame, 0);
-		int stride = vsapi->getStride(dst_frame, 0);
+		VSFrameRef *dst_frame = 0;
+		const VSFrameRef *ref_frame = 0;
+		const VSFrameRef *temporal_frames[EDGEFIXER_TEMPORAL_MAX] = { 0 };
+		int num_temporal = 0;
+		const uint8_t *ref_ptrs[3];
+		int ref_strides[3];
+		uint8_t *strips = 0;
+		void *tmp = 0;
+		edgefixer_edge_stats *stats = 0;
+		vs_edgefix_rect rect;
+		const char *error;
+		int p;
+
+		if (vs_edgefix_in_range(&params, n) && (error = vs_edgefix_frame_edges(&params, n, src_frame, vsapi))) {
+			vsapi->setFilterError(error, frameCtx);
+			goto fail;
+		}
+		plane_lines = params.fields * vs_edgefix_num_lines(&params);
+
+		if (!vs_edgefix_in_range(&params, n) || !vs_edgefix_num_lines(&params) || !vs_edgefix_active(src_frame, &params, vsapi, &rect)) {
+			if (!vs_edgefix_cropping(&params))
+				return src_frame;
+			ret = vs_edgefix_crop(src_frame, &params, core, vsapi);
+			goto fail;
+		}
+
+		if (params.temporal) {
+			/* Smooth only the border lines being fixed, and use them as reference strips. */
+			const void *ptrs[EDGEFIXER_TEMPORAL_MAX];
+			int strides[EDGEFIXER_TEMPORAL_MAX];
+			int strips_stride = edgefixer_strips_width(rect.width, rect.height) * format->bytesPerSample;
+			int first, last, i;
+
+			vs_edgefix_temporal_range(&params, n, &first, &last);
+			for (i = first; i <= last; ++i)
+				temporal_frames[num_temporal++] = vsapi->getFrameFilter(i, vs_edgefix_temporal_node(&params), frameCtx);
+
+			strips = malloc((size_t)params.num_planes * strips_stride * vs_edgefix_num_lines(&params));
+			if (!strips) {
+				vsapi->setFilterError("error allocating buffer", frameCtx);
+				goto fail;
+			}
 
-		const VSFrameRef *ref_frame = vsapi->getFrameFilter(n, data->ref_node, frameCtx);
-		const uint8_t *ref_ptr = vsapi->getReadPtr(ref_frame, 0);
-		int ref_stride = vsapi->getStride(ref_frame, 0);
-		int step = format->bytesPerSample;
+			for (p = 0; p < params.num_planes; ++p) {
+				for (i = 0; i < num_temporal; ++i) {
+					ptrs[i] = vs_edgefix_read_ptr(temporal_frames[i], p, &params, &rect, vsapi);
+					strides[i] = vsapi->getStride(temporal_frames[i], p);
+				}
+				ref_ptrs[p] = strips + (size_t)p * strips_stride * vs_edgefix_num_lines(&params);
+				ref_strides[p] = strips_stride;
+				edgefixer_temporal_strips(type, ptrs, strides, num_temporal, rect.width, rect.height, params.left, params.top, params.right, params.bottom, params.temporal_median, (uint8_t *)ref_ptrs[p], strips_stride);
+			}
 
-		void *tmp = malloc(required_buffer(width > height ? width : height));
+			params.strips = 1;
+			params.strip_left = params.left;
+			params.strip_top = params.top;
+			params.strip_right = params.right;
+			params.strip_bottom = params.bottom;
+		} else {
+			ref_frame = vsapi->getFrameFilter(n, params.ref_node, frameCtx);
+			for (p = 0; p < params.num_planes; ++p) {
+				ref_ptrs[p] = vs_edgefix_ref_ptr(ref_frame, p, &params, &rect, vsapi);
+				ref_strides[p] = vsapi->getStride(ref_frame, p);
+			}
+		}
+
+		tmp = malloc(vs_edgefix_ref_scaled(&params) ? edgefixer_required_buffer_scaled(type, width, height) : edgefixer_required_buffer(type, width, height));
 		if (!tmp) {
 			vsapi->setFilterError("error allocating buffer", frameCtx);
 			goto fail;
 		}
 
-		for (i = 0; i < data->top; ++i) {
-			process_edge(ptr + stride * i, ref_ptr + ref_stride * i, step, step, width, data->radius, tmp);
-		}
-		for (i = 0; i < data->bottom; ++i) {
-			process_edge(ptr + stride * (data->vi.height - i - 1), ref_ptr + ref_stride * (height - i - 1), step, step, width, data->radius, tmp);
-		}
-		for (i = 0; i < data->left; ++i) {
-			process_edge(ptr + step * i, ref_ptr + step * i, stride, ref_stride, height, data->radius, tmp);
+		if (params.measure) {
+			stats = malloc(params.num_planes * plane_lines * sizeof(edgefixer_edge_stats));
+			if (!stats) {
+				vsapi->setFilterError("error allocating buffer", frameCtx);
+				goto fail;
+			}
+
+			for (p = 0; p < params.num_planes; ++p)
+				vs_reference_plane_measure(&params, type, vs_edgefix_read_ptr(src_frame, p, &params, &rect, vsapi), vsapi->getStride(src_frame, p), ref_ptrs[p], ref_strides[p], rect.width, rect.height, tmp, stats + p * plane_lines);
+
+			dst_frame = vs_edgefix_cropping(&params) ? vs_edgefix_crop(src_frame, &params, core, vsapi) : vsapi->copyFrame(src_frame, core);
+			vs_edgefix_set_props(vsapi->getFramePropsRW(dst_frame), stats, &params, &rect, vsapi);
+			ret = dst_frame;
+			dst_frame = 0;
+			goto fail;
 		}
-		for (i = 0; i < data->right; ++i) {
-			process_edge(ptr + step * (width - i - 1), ref_ptr + step * (width - i - 1), stride, ref_stride, height, data->radius, tmp);
+
+		/* A cropped frame is a new frame either way, so only skip the copy when not cropping. */
+		if (params.passthrough && !vs_edgefix_cropping(&params)) {
+			int changes = 0;
+
+			for (p = 0; p < params.num_planes && !changes; ++p)
+				changes = vs_reference_plane_changes(&params, type, vs_edgefix_read_ptr(src_frame, p, &params, &rect, vsapi), vsapi->getStride(src_frame, p), ref_ptrs[p], ref_strides[p], rect.width, rect.height, tmp);
+
+			if (!changes) {
+				ret = src_frame;
+				src_frame = 0;
+				goto fail;
+			}
 		}
 
+		if (vs_edgefix_cropping(&params))
+			dst_frame = vs_edgefix_crop(src_frame, &params, core, vsapi);
+		else
+			dst_frame = vsapi->newVideoFrame2(format, width, height, src_planes, plane_order, src_frame, core);
+
+		for (p = 0; p < params.num_planes; ++p)
+			vs_reference_plane(&params, type, vs_edgefix_write_ptr(dst_frame, p, &params, &rect, vsapi), vsapi->getStride(dst_frame, p), ref_ptrs[p], ref_strides[p], rect.width, rect.height, tmp);
+
 		ret = dst_frame;
 		dst_frame = 0;
 	fail:
 		vsapi->freeFrame(src_frame);
 		vsapi->freeFrame(dst_frame);
 		vsapi->freeFrame(ref_frame);
+		for (p = 0; p < num_temporal; ++p)
+			vsapi->freeFrame(temporal_frames[p]);
+		free(strips);
 		free(tmp);
+		free(stats);
 	}
 
 	return ret;
@@ -145,6 +697,7 @@ static void VS_CC vs_edgefix_free(void *instanceData, VSCore *core, const VSAPI
 
 	vsapi->freeNode(data->node);
 	vsapi->freeNode(data->ref_node);
+	free(data->zones);
 	free(data);
 }
 
@@ -155,11 +708,20 @@ static void VS_CC vs_edgefix_create(const VSMap *in, VSMap *out, void *userData,
 	VSNodeRef *ref_node = 0;
 	VSVideoInfo vi;
 	int left, top, right, bottom, radius;
+	int first, last, passthrough, measure, fields, sample;
+	int crop_left, crop_top, crop_right, crop_bottom;
+	int active_x, active_y, active_width, active_height, detect;
+	vs_edgefix_zone *zones = 0;
+	int num_zones, frame_props;
+	int ref_scale_x = 1, ref_scale_y = 1;
+	int num_strips, strip_left = 0, strip_top = 0, strip_right = 0, strip_bottom = 0;
+	int temporal, temporal_median;
 	int err;
+	int i;
 
 	node = vsapi->propGetNode(in, "clip", 0, 0);
 	if ((intptr_t)userData)
-		ref_node = vsapi->propGetNode(in, "ref", 0, 0);
+		ref_node = vsapi->propGetNode(in, "ref", 0, &err);
 
 	vi = *vsapi->getVideoInfo(node);
 
@@ -183,34 +745,236 @@ static void VS_CC vs_edgefix_create(const VSMap *in, VSMap *out, void *userData,
 	if (err)
 		radius = 0;
 
-	if (vi.format->colorFamily == cmRGB) {
-		vsapi->setError(out, "only YUV is supported");
-		goto fail;
-	}
+	first = (int)vsapi->propGetInt(in, "first", 0, &err);
+	if (err)
+		first = 0;
+
+	last = (int)vsapi->propGetInt(in, "last", 0, &err);
+	if (err)
+		last = vi.numFrames ? vi.numFrames - 1 : INT_MAX;
+
+	passthrough = !!vsapi->propGetInt(in, "passthrough", 0, &err);
+	if (err)
+		passthrough = 0;
+
+	measure = !!vsapi->propGetInt(in, "measure", 0, &err);
+	if (err)
+		measure = 0;
+
+	fields = vsapi->propGetInt(in, "fields", 0, &err) ? 2 : 1;
+
+	sample = (int)vsapi->propGetInt(in, "sample", 0, &err);
+	if (err)
+		sample = 1;
+
+	crop_left = (int)vsapi->propGetInt(in, "cropleft", 0, &err);
+	if (err)
+		crop_left = 0;
+
+	crop_top = (int)vsapi->propGetInt(in, "croptop", 0, &err);
+	if (err)
+		crop_top = 0;
+
+	crop_right = (int)vsapi->propGetInt(in, "cropright", 0, &err);
+	if (err)
+		crop_right = 0;
+
+	crop_bottom = (int)vsapi->propGetInt(in, "cropbottom", 0, &err);
+	if (err)
+		crop_bottom = 0;
+
+	active_x = (int)vsapi->propGetInt(in, "activex", 0, &err);
+	if (err)
+		active_x = 0;
+
+	active_y = (int)vsapi->propGetInt(in, "activey", 0, &err);
+	if (err)
+		active_y = 0;
+
+	active_width = (int)vsapi->propGetInt(in, "activewidth", 0, &err);
+	if (err)
+		active_width = 0;
+
+	active_height = (int)vsapi->propGetInt(in, "activeheight", 0, &err);
+	if (err)
+		active_height = 0;
+
+	detect = (int)vsapi->propGetInt(in, "detect", 0, &err);
+	if (err)
+		detect = -1;
+
+	frame_props = !!vsapi->propGetInt(in, "frameprops", 0, &err);
+	if (err)
+		frame_props = 0;
+
+	num_zones = vsapi->propNumElements(in, "zones");
+	if (num_zones < 0)
+		num_zones = 0;
+
+	num_strips = vsapi->propNumElements(in, "strips");
+	if (num_strips < 0)
+		num_strips = 0;
+
+	temporal = (int)vsapi->propGetInt(in, "temporal", 0, &err);
+	if (err)
+		temporal = 0;
+
+	temporal_median = !!vsapi->propGetInt(in, "temporalmedian", 0, &err);
+	if (err)
+		temporal_median = 0;
+
 	if (vi.format->bytesPerSample > 2 || vi.format->sampleType != stInteger) {
 		vsapi->setError(out, "only BYTE and WORD are supported");
 		goto fail;
 	}
-	if (ref_node && !isSameFormat(&vi, vsapi->getVideoInfo(ref_node))) {
-		vsapi->setError(out, "clip and reference must have same format");
+	if ((intptr_t)userData && !ref_node && !temporal) {
+		vsapi->setError(out, "ref is required unless temporal is set");
+		goto fail;
+	}
+	if (temporal < 0 || temporal > (EDGEFIXER_TEMPORAL_MAX - 1) / 2) {
+		vsapi->setError(out, "temporal must be between 0 and 15");
 		goto fail;
 	}
+	if (temporal && (num_strips || fields > 1 || sample > 1)) {
+		vsapi->setError(out, "temporal cannot be combined with strips, fields or sample");
+		goto fail;
+	}
+
+	if (num_strips) {
+		const VSVideoInfo *ref_vi = vsapi->getVideoInfo(ref_node);
+
+		if (num_strips != 4) {
+			vsapi->setError(out, "strips must hold 4 values: left, top, right, bottom");
+			goto fail;
+		}
+		strip_left = (int)vsapi->propGetInt(in, "strips", 0, 0);
+		strip_top = (int)vsapi->propGetInt(in, "strips", 1, 0);
+		strip_right = (int)vsapi->propGetInt(in, "strips", 2, 0);
+		strip_bottom = (int)vsapi->propGetInt(in, "strips", 3, 0);
+
+		if (ref_vi->format != vi.format || ref_vi->width != edgefixer_strips_width(vi.width, vi.height) || ref_vi->height != strip_left + strip_top + strip_right + strip_bottom) {
+			vsapi->setError(out, "reference strips must have the clip's format and the size extracted with these depths");
+			goto fail;
+		}
+		if (crop_left | crop_top | crop_right | crop_bottom | active_x | active_y | active_width | active_height || detect >= 0 || fields > 1 || sample > 1) {
+			vsapi->setError(out, "reference strips cannot be combined with crop, active region, detect, fields or sample");
+			goto fail;
+		}
+	} else if (ref_node) {
+		const VSVideoInfo *ref_vi = vsapi->getVideoInfo(ref_node);
+
+		/* The reference may be smaller by a whole factor, such as half or quarter size. */
+		if (ref_vi->format != vi.format || !ref_vi->width || !ref_vi->height || vi.width % ref_vi->width || vi.height % ref_vi->height) {
+			vsapi->setError(out, "reference must have the clip's format and a size that divides the clip's");
+			goto fail;
+		}
+		ref_scale_x = vi.width / ref_vi->width;
+		ref_scale_y = vi.height / ref_vi->height;
+		if (temporal && (ref_scale_x > 1 || ref_scale_y > 1)) {
+			vsapi->setError(out, "temporal requires a full-size reference");
+			goto fail;
+		}
+		/* Reference rows split into fields would not lie on the field's parity. */
+		if (fields > 1 && ref_scale_y > 1) {
+			vsapi->setError(out, "fields requires a reference of the clip's height");
+			goto fail;
+		}
+	}
+
+	if (sample < 1) {
+		vsapi->setError(out, "sample must be at least 1");
+		goto fail;
+	}
+	if (sample > 1 && radius) {
+		vsapi->setError(out, "sample requires radius 0");
+		goto fail;
+	}
+
+	if (crop_left < 0 || crop_top < 0 || crop_right < 0 || crop_bottom < 0) {
+		vsapi->setError(out, "crop margins must not be negative");
+		goto fail;
+	}
+	if (crop_left + crop_right >= vi.width || crop_top + crop_bottom >= vi.height) {
+		vsapi->setError(out, "cropped frame would be empty");
+		goto fail;
+	}
+	if ((crop_left | crop_right) & ((1 << vi.format->subSamplingW) - 1) || (crop_top | crop_bottom) & ((1 << vi.format->subSamplingH) - 1)) {
+		vsapi->setError(out, "crop margins must be a multiple of the chroma subsampling");
+		goto fail;
+	}
+	vi.width -= crop_left + crop_right;
+	vi.height -= crop_top + crop_bottom;
+
+	/* The active region is relative to the output; 0 extends it to the far border. */
+	if (!active_width)
+		active_width = vi.width - active_x;
+	if (!active_height)
+		active_height = vi.height - active_y;
+	if (active_x < 0 || active_y < 0 || active_width <= 0 || active_height <= 0 || active_x + active_width > vi.width || active_y + active_height > vi.height) {
+		vsapi->setError(out, "active region must lie within the frame");
+		goto fail;
+	}
+	if (active_y % fields) {
+		vsapi->setError(out, "active region must start on a top field line");
+		goto fail;
+	}
+
+	if (ref_scale_x > 1 || ref_scale_y > 1) {
+		if (sample > 1) {
+			vsapi->setError(out, "sample requires a full-size reference");
+			goto fail;
+		}
+		if (crop_left % ref_scale_x || crop_right % ref_scale_x || active_x % ref_scale_x || active_width % ref_scale_x ||
+		    crop_top % ref_scale_y || crop_bottom % ref_scale_y || active_height % ref_scale_y || active_y % (fields * ref_scale_y)) {
+			vsapi->setError(out, "crop margins and active region must be a multiple of the reference scale");
+			goto fail;
+		}
+	}
 
 	if (left < 0 || right < 0 || top < 0 || bottom < 0) {
 		vsapi->setError(out, "too few edges to fix");
 		goto fail;
 	}
-	if (left > vi.width || right > vi.width || top > vi.height || bottom > vi.height) {
+	if (left > active_width || right > active_width || top > active_height / fields || bottom > active_height / fields) {
 		vsapi->setError(out, "too many edges to fix");
 		goto fail;
 	}
+	if (num_strips && (left > strip_left || top > strip_top || right > strip_right || bottom > strip_bottom)) {
+		vsapi->setError(out, "edges must lie within the reference strips");
+		goto fail;
+	}
+
+	if (num_zones % 7) {
+		vsapi->setError(out, "zones must hold 7 values per zone: first, last, left, top, right, bottom, radius");
+		goto fail;
+	}
+	num_zones /= 7;
+
+	/* Nothing to fix or crop, so hand back the input node rather than a filter. */
+	if (!(left | top | right | bottom | crop_left | crop_top | crop_right | crop_bottom | num_zones | frame_props)) {
+		vsapi->propSetNode(out, "clip", node, paReplace);
+		vsapi->freeNode(node);
+		vsapi->freeNode(ref_node);
+		return;
+	}
 
 	data = malloc(sizeof(vs_edgefix_data));
-	if (!data) {
+	zones = num_zones ? malloc(num_zones * sizeof(vs_edgefix_zone)) : 0;
+	if (!data || (num_zones && !zones)) {
 		vsapi->setError(out, "error allocating data");
 		goto fail;
 	}
 
+	for (i = 0; i < num_zones; ++i) {
+		zones[i].first = (int)vsapi->propGetInt(in, "zones", i * 7 + 0, 0);
+		zones[i].last = (int)vsapi->propGetInt(in, "zones", i * 7 + 1, 0);
+		zones[i].left = (int)vsapi->propGetInt(in, "zones", i * 7 + 2, 0);
+		zones[i].top = (int)vsapi->propGetInt(in, "zones", i * 7 + 3, 0);
+		zones[i].right = (int)vsapi->propGetInt(in, "zones", i * 7 + 4, 0);
+		zones[i].bottom = (int)vsapi->propGetInt(in, "zones", i * 7 + 5, 0);
+		zones[i].radius = (int)vsapi->propGetInt(in, "zones", i * 7 + 6, 0);
+	}
+
 	data->node = node;
 	data->ref_node = ref_node;
 	data->vi = vi;
@@ -219,18 +983,414 @@ static void VS_CC vs_edgefix_create(const VSMap *in, VSMap *out, void *userData,
 	data->right = right;
 	data->bottom = bottom;
 	data->radius = radius;
+	data->first = first;
+	data->last = last;
+	data->passthrough = passthrough;
+	data->measure = measure;
+	data->fields = fields;
+	data->sample = sample;
+	data->num_planes = vi.format->colorFamily == cmRGB ? 3 : 1;
+	data->crop_left = crop_left;
+	data->crop_top = crop_top;
+	data->crop_right = crop_right;
+	data->crop_bottom = crop_bottom;
+	data->active_x = active_x;
+	data->active_y = active_y;
+	data->active_width = active_width;
+	data->active_height = active_height;
+	data->detect = detect;
+	data->zones = zones;
+	data->num_zones = num_zones;
+	data->frame_props = frame_props;
+	data->ref_scale_x = ref_scale_x;
+	data->ref_scale_y = ref_scale_y;
+	data->strips = !!num_strips;
+	data->strip_left = strip_left;
+	data->strip_top = strip_top;
+	data->strip_right = strip_right;
+	data->strip_bottom = strip_bottom;
+	data->temporal = temporal;
+	data->temporal_median = temporal_median;
+
+	/* Zones are checked like the edges above; frame properties are checked per frame. */
+	for (i = 0; i < num_zones; ++i) {
+		vs_edgefix_data zone_data = *data;
+		const char *error;
 
-	vsapi->createFilter(in, out, "edgefixer", vs_edgefix_init, ref_node ? vs_reference_get_frame : vs_continuity_get_frame, vs_edgefix_free, fmParallel, 0, data, core);
+		vs_edgefix_apply_zone(&zone_data, zones + i);
+		if ((error = vs_edgefix_check_edges(&zone_data))) {
+			char msg[80];
+
+			snprintf(msg, sizeof(msg), "zone %d: %s", i, error);
+			vsapi->setError(out, msg);
+			goto fail;
+		}
+	}
+
+	vsapi->createFilter(in, out, "edgefixer", vs_edgefix_init, (intptr_t)userData ? vs_reference_get_frame : vs_continuity_get_frame, vs_edgefix_free, fmParallel, 0, data, core);
 	return;
 fail:
+	free(zones);
 	free(data);
 	return;
 }
 
+/* One edge specification of Multi: ref is an index into its refs, or -1 for
+ * continuity; planes is a mask of plane indices. */
+typedef struct vs_multi_spec {
+	int ref;
+	int left;
+	int top;
+	int right;
+	int bottom;
+	int radius;
+	int planes;
+} vs_multi_spec;
+
+typedef struct vs_multi_data {
+	VSNodeRef *node;
+	VSNodeRef **refs;
+	int num_refs;
+	vs_multi_spec *specs;
+	int num_specs;
+	VSVideoInfo vi;
+} vs_multi_data;
+
+static void VS_CC vs_multi_init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi)
+{
+	const vs_multi_data *data = *instanceData;
+	vsapi->setVideoInfo(&data->vi, 1, node);
+}
+
+/* Apply every spec in order to a single copy of the frame, so each sees the
+ * lines fixed by those before it, as with chained filters. */
+static const VSFrameRef * VS_CC vs_multi_get_frame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
+{
+	vs_multi_data *data = *instanceData;
+	const VSFrameRef *ret = 0;
+	int i;
+
+	if (activationReason == arInitial) {
+		vsapi->requestFrameFilter(n, data->node, frameCtx);
+		for (i = 0; i < data->num_refs; ++i)
+			vsapi->requestFrameFilter(n, data->refs[i], frameCtx);
+	} else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, data->node, frameCtx);
+		const VSFrameRef *src_planes[3] = { src_frame, src_frame, src_frame };
+		const VSFormat *format = vsapi->getFrameFormat(src_frame);
+		int plane_order[3] = { 0, 1, 2 };
+		int width = vsapi->getFrameWidth(src_frame, 0);
+		int height = vsapi->getFrameHeight(src_frame, 0);
+		edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+
+		/* Planes are copied on first write, so untouched planes stay shared. */
+		VSFrameRef *dst_frame = vsapi->newVideoFrame2(format, width, height, src_planes, plane_order, src_frame, core);
+		void *tmp = malloc(edgefixer_required_buffer(type, width, height));
+
+		if (!tmp) {
+			vsapi->setFilterError("error allocating buffer", frameCtx);
+			goto fail;
+		}
+
+		for (i = 0; i < data->num_specs; ++i) {
+			const vs_multi_spec *spec = data->specs + i;
+			const VSFrameRef *ref_frame = spec->ref >= 0 ? vsapi->getFrameFilter(n, data->refs[spec->ref], frameCtx) : 0;
+			int p;
+
+			for (p = 0; p < format->numPlanes; ++p) {
+				if (!(spec->planes & (1 << p)))
+					continue;
+
+				if (ref_frame)
+					edgefixer_reference(type, vsapi->getWritePtr(dst_frame, p), vsapi->getStride(dst_frame, p), vsapi->getReadPtr(ref_frame, p), vsapi->getStride(ref_frame, p),
+					                    vsapi->getFrameWidth(dst_frame, p), vsapi->getFrameHeight(dst_frame, p), spec->left, spec->top, spec->right, spec->bottom, spec->radius, tmp);
+				else
+					edgefixer_continuity(type, vsapi->getWritePtr(dst_frame, p), vsapi->getStride(dst_frame, p),
+					                     vsapi->getFrameWidth(dst_frame, p), vsapi->getFrameHeight(dst_frame, p), spec->left, spec->top, spec->right, spec->bottom, spec->radius, tmp);
+			}
+			vsapi->freeFrame(ref_frame);
+		}
+
+		ret = dst_frame;
+		dst_frame = 0;
+	fail:
+		vsapi->freeFrame(src_frame);
+		vsapi->freeFrame(dst_frame);
+		free(tmp);
+	}
+
+	return ret;
+}
+
+static void VS_CC vs_multi_free(void *instanceData, VSCore *core, const VSAPI *vsapi)
+{
+	vs_multi_data *data = instanceData;
+	int i;
+
+	vsapi->freeNode(data->node);
+	for (i = 0; i < data->num_refs; ++i)
+		vsapi->freeNode(data->refs[i]);
+	free(data->refs);
+	free(data->specs);
+	free(data);
+}
+
+static void VS_CC vs_multi_create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+	vs_multi_data *data = calloc(1, sizeof(vs_multi_data));
+	const VSVideoInfo *vi;
+	char msg[80];
+	int num_refs;
+	int num_values;
+	int i;
+
+	if (!data) {
+		vsapi->setError(out, "error allocating data");
+		return;
+	}
+
+	data->node = vsapi->propGetNode(in, "clip", 0, 0);
+	vi = vsapi->getVideoInfo(data->node);
+	data->vi = *vi;
+
+	/* num_refs is only set once refs exists, so vs_multi_free can always walk it. */
+	num_refs = vsapi->propNumElements(in, "refs");
+	if (num_refs < 0)
+		num_refs = 0;
+	data->refs = calloc(num_refs + 1, sizeof(VSNodeRef *));
+	if (!data->refs) {
+		vsapi->setError(out, "error allocating data");
+		goto fail;
+	}
+	data->num_refs = num_refs;
+	for (i = 0; i < data->num_refs; ++i) {
+		data->refs[i] = vsapi->propGetNode(in, "refs", i, 0);
+		if (!isSameFormat(vi, vsapi->getVideoInfo(data->refs[i]))) {
+			vsapi->setError(out, "clip and references must have same format");
+			goto fail;
+		}
+	}
+
+	if (!isConstantFormat(vi) || vi->format->bytesPerSample > 2 || vi->format->sampleType != stInteger) {
+		vsapi->setError(out, "only constant format BYTE and WORD are supported");
+		goto fail;
+	}
+
+	num_values = vsapi->propNumElements(in, "specs");
+	if (num_values <= 0 || num_values % 7) {
+		vsapi->setError(out, "specs must hold 7 values per spec: ref, left, top, right, bottom, radius, planes");
+		goto fail;
+	}
+	data->num_specs = num_values / 7;
+	data->specs = malloc(data->num_specs * sizeof(vs_multi_spec));
+	if (!data->specs) {
+		vsapi->setError(out, "error allocating data");
+		goto fail;
+	}
+
+	for (i = 0; i < data->num_specs; ++i) {
+		vs_multi_spec *spec = data->specs + i;
+		const char *error = 0;
+		int p;
+
+		spec->ref = (int)vsapi->propGetInt(in, "specs", i * 7 + 0, 0);
+		spec->left = (int)vsapi->propGetInt(in, "specs", i * 7 + 1, 0);
+		spec->top = (int)vsapi->propGetInt(in, "specs", i * 7 + 2, 0);
+		spec->right = (int)vsapi->propGetInt(in, "specs", i * 7 + 3, 0);
+		spec->bottom = (int)vsapi->propGetInt(in, "specs", i * 7 + 4, 0);
+		spec->radius = (int)vsapi->propGetInt(in, "specs", i * 7 + 5, 0);
+		spec->planes = (int)vsapi->propGetInt(in, "specs", i * 7 + 6, 0);
+
+		if (spec->ref < -1 || spec->ref >= data->num_refs)
+			error = "ref must be -1 or an index into refs";
+		else if (spec->planes <= 0 || spec->planes >> vi->format->numPlanes)
+			error = "planes must select planes of the clip";
+		else if (spec->left < 0 || spec->top < 0 || spec->right < 0 || spec->bottom < 0)
+			error = "too few edges to fix";
+
+		for (p = 0; p < vi->format->numPlanes && !error; ++p) {
+			int plane_width = vi->width >> (p ? vi->format->subSamplingW : 0);
+			int plane_height = vi->height >> (p ? vi->format->subSamplingH : 0);
+
+			if (spec->planes & (1 << p) && (spec->left > plane_width || spec->right > plane_width || spec->top > plane_height || spec->bottom > plane_height))
+				error = "too many edges to fix";
+		}
+
+		if (error) {
+			snprintf(msg, sizeof(msg), "spec %d: %s", i, error);
+			vsapi->setError(out, msg);
+			goto fail;
+		}
+	}
+
+	vsapi->createFilter(in, out, "edgefixer", vs_multi_init, vs_multi_get_frame, vs_multi_free, fmParallel, 0, data, core);
+	return;
+fail:
+	vs_multi_free(data, core, vsapi);
+}
+
+/* Border strips of the clip as laid out by edgefixer_extract_strips. For
+ * InsertStrips, strips_node holds the strips to write back. */
+typedef struct vs_strips_data {
+	VSNodeRef *node;
+	VSNodeRef *strips_node;
+	VSVideoInfo vi;
+	int left;
+	int top;
+	int right;
+	int bottom;
+} vs_strips_data;
+
+static void VS_CC vs_strips_init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi)
+{
+	const vs_strips_data *data = *instanceData;
+	vsapi->setVideoInfo(&data->vi, 1, node);
+}
+
+static const VSFrameRef * VS_CC vs_extract_strips_get_frame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
+{
+	vs_strips_data *data = *instanceData;
+	const VSFrameRef *ret = 0;
+
+	if (activationReason == arInitial) {
+		vsapi->requestFrameFilter(n, data->node, frameCtx);
+	} else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, data->node, frameCtx);
+		const VSFormat *format = vsapi->getFrameFormat(src_frame);
+		edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+		VSFrameRef *dst_frame = vsapi->newVideoFrame(format, data->vi.width, data->vi.height, src_frame, core);
+		int p;
+
+		for (p = 0; p < format->numPlanes; ++p) {
+			int ss = p ? format->subSamplingW : 0;
+
+			edgefixer_extract_strips(type, vsapi->getReadPtr(src_frame, p), vsapi->getStride(src_frame, p), vsapi->getFrameWidth(src_frame, p), vsapi->getFrameHeight(src_frame, p),
+			                         data->left >> ss, data->top >> ss, data->right >> ss, data->bottom >> ss, vsapi->getWritePtr(dst_frame, p), vsapi->getStride(dst_frame, p));
+		}
+
+		vsapi->freeFrame(src_frame);
+		ret = dst_frame;
+	}
+
+	return ret;
+}
+
+static const VSFrameRef * VS_CC vs_insert_strips_get_frame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi)
+{
+	vs_strips_data *data = *instanceData;
+	const VSFrameRef *ret = 0;
+
+	if (activationReason == arInitial) {
+		vsapi->requestFrameFilter(n, data->node, frameCtx);
+		vsapi->requestFrameFilter(n, data->strips_node, frameCtx);
+	} else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *src_frame = vsapi->getFrameFilter(n, data->node, frameCtx);
+		const VSFrameRef *strips_frame = vsapi->getFrameFilter(n, data->strips_node, frameCtx);
+		const VSFormat *format = vsapi->getFrameFormat(src_frame);
+		edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+		VSFrameRef *dst_frame = vsapi->copyFrame(src_frame, core);
+		int p;
+
+		for (p = 0; p < format->numPlanes; ++p) {
+			int ss = p ? format->subSamplingW : 0;
+
+			edgefixer_insert_strips(type, vsapi->getWritePtr(dst_frame, p), vsapi->getStride(dst_frame, p), vsapi->getFrameWidth(dst_frame, p), vsapi->getFrameHeight(dst_frame, p),
+			                        data->left >> ss, data->top >> ss, data->right >> ss, data->bottom >> ss, vsapi->getReadPtr(strips_frame, p), vsapi->getStride(strips_frame, p));
+		}
+
+		vsapi->freeFrame(src_frame);
+		vsapi->freeFrame(strips_frame);
+		ret = dst_frame;
+	}
+
+	return ret;
+}
+
+static void VS_CC vs_strips_free(void *instanceData, VSCore *core, const VSAPI *vsapi)
+{
+	vs_strips_data *data = instanceData;
+
+	vsapi->freeNode(data->node);
+	vsapi->freeNode(data->strips_node);
+	free(data);
+}
+
+static void VS_CC vs_strips_create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi)
+{
+	vs_strips_data *data = calloc(1, sizeof(vs_strips_data));
+	const VSVideoInfo *vi;
+	VSVideoInfo strips_vi;
+	int ss;
+	int err;
+
+	if (!data) {
+		vsapi->setError(out, "error allocating data");
+		return;
+	}
+
+	data->node = vsapi->propGetNode(in, "clip", 0, 0);
+	if ((intptr_t)userData)
+		data->strips_node = vsapi->propGetNode(in, "strips", 0, 0);
+	vi = vsapi->getVideoInfo(data->node);
+
+	data->left = (int)vsapi->propGetInt(in, "left", 0, &err);
+	data->top = (int)vsapi->propGetInt(in, "top", 0, &err);
+	data->right = (int)vsapi->propGetInt(in, "right", 0, &err);
+	data->bottom = (int)vsapi->propGetInt(in, "bottom", 0, &err);
+
+	if (!isConstantFormat(vi) || vi->format->bytesPerSample > 2 || vi->format->sampleType != stInteger) {
+		vsapi->setError(out, "only constant format BYTE and WORD are supported");
+		goto fail;
+	}
+
+	/* Columns become lines, so the chroma planes need square subsampling. */
+	if (vi->format->subSamplingW != vi->format->subSamplingH) {
+		vsapi->setError(out, "strips require the same horizontal and vertical subsampling");
+		goto fail;
+	}
+	ss = (1 << vi->format->subSamplingW) - 1;
+
+	if (data->left < 0 || data->top < 0 || data->right < 0 || data->bottom < 0 || !(data->left | data->top | data->right | data->bottom)) {
+		vsapi->setError(out, "strip depths must not be negative, and at least one must be set");
+		goto fail;
+	}
+	if (data->left > vi->width || data->right > vi->width || data->top > vi->height || data->bottom > vi->height) {
+		vsapi->setError(out, "strips must lie within the frame");
+		goto fail;
+	}
+	if ((data->left | data->top | data->right | data->bottom) & ss) {
+		vsapi->setError(out, "strip depths must be a multiple of the chroma subsampling");
+		goto fail;
+	}
+
+	/* ExtractStrips outputs the strips; InsertStrips takes them and outputs the clip. */
+	strips_vi = *vi;
+	strips_vi.width = edgefixer_strips_width(vi->width, vi->height);
+	strips_vi.height = data->left + data->top + data->right + data->bottom;
+	data->vi = data->strips_node ? *vi : strips_vi;
+
+	if (data->strips_node) {
+		const VSVideoInfo *in_vi = vsapi->getVideoInfo(data->strips_node);
+
+		if (in_vi->format != vi->format || in_vi->width != strips_vi.width || in_vi->height != strips_vi.height) {
+			vsapi->setError(out, "strips must have the clip's format and the size extracted with these depths");
+			goto fail;
+		}
+	}
+
+	vsapi->createFilter(in, out, "edgefixer", vs_strips_init, data->strips_node ? vs_insert_strips_get_frame : vs_extract_strips_get_frame, vs_strips_free, fmParallel, 0, data, core);
+	return;
+fail:
+	vs_strips_free(data, core, vsapi);
+}
+
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin)
 {
 	configFunc("the.weather.channel", "edgefixer", "ultraman", VAPOURSYNTH_API_VERSION, 1, plugin);
 
-	registerFunc("Continuity", "clip:clip;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;radius:int:opt;", vs_edgefix_create, (void *)0, plugin);
-	registerFunc("Reference", "clip:clip;ref:clip;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;radius:int:opt;", vs_edgefix_create, (void *)1, plugin);
+	registerFunc("Continuity", "clip:clip;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;radius:int:opt;first:int:opt;last:int:opt;passthrough:int:opt;measure:int:opt;fields:int:opt;sample:int:opt;cropleft:int:opt;croptop:int:opt;cropright:int:opt;cropbottom:int:opt;activex:int:opt;activey:int:opt;activewidth:int:opt;activeheight:int:opt;detect:int:opt;zones:int[]:opt;frameprops:int:opt;", vs_edgefix_create, (void *)0, plugin);
+	registerFunc("Reference", "clip:clip;ref:clip:opt;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;radius:int:opt;first:int:opt;last:int:opt;passthrough:int:opt;measure:int:opt;fields:int:opt;sample:int:opt;cropleft:int:opt;croptop:int:opt;cropright:int:opt;cropbottom:int:opt;activex:int:opt;activey:int:opt;activewidth:int:opt;activeheight:int:opt;detect:int:opt;zones:int[]:opt;frameprops:int:opt;strips:int[]:opt;temporal:int:opt;temporalmedian:int:opt;", vs_edgefix_create, (void *)1, plugin);
+	registerFunc("Multi", "clip:clip;specs:int[];refs:clip[]:opt;", vs_multi_create, 0, plugin);
+	registerFunc("ExtractStrips", "clip:clip;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;", vs_strips_create, (void *)0, plugin);
+	registerFunc("InsertStrips", "clip:clip;strips:clip;left:int:opt;top:int:opt;right:int:opt;bottom:int:opt;", vs_strips_create, (void *)1, plugin);
 }
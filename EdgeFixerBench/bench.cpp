@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mockavs.h"
+#include "mockvs.h"
+
+extern "C" {
+#include "edgefixer.h"
+}
+
+extern "C" void VS_CC VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
+extern "C" const char *__stdcall AvisynthPluginInit3(IScriptEnvironment *env, const AVS_Linkage *const vectors);
+
+// Runs Continuity, Reference or Multi from vsplugin.c against the mock core,
+// or ContinuityFixer, ReferenceFixer or MultiFixer from avsplugin.cpp against
+// the mock AviSynth+ environment, and reports throughput and per-frame
+// latency, including the host-side work (frame allocation, plane copies,
+// temporary buffers) a kernel benchmark leaves out.
+//
+// Usage: EdgeFixerBench Continuity|Reference|Multi|Sample|Precision [key=value ...]
+//   width, height, frames, threads, pool - clip size, worker count and number
+//                                           of distinct source frames
+//   format=gray|yuv420|yuv422|yuv444|rgb, bits=8..16
+//   host=vs|avs - the plugin to run
+//   any other key is passed to the filter as an int argument, or as a bool
+//   for the bool arguments of the AviSynth filters
+//
+// Multi applies left, top, right, bottom and radius as two specs: continuity
+// on the first plane, then the reference on the others, or on the first
+// plane again for gray clips.
+//
+// Sample runs Continuity through the core directly, once with the full fit
+// and once with the fit from every sample-th sample, and reports the time of
+// each and the difference between their outputs. With host=avs it runs
+// ContinuityFixer twice instead, with sample=1 and with sample, and compares
+// the first plane of their frames.
+//
+// Precision runs Continuity through the core on 8-bit frames, and on the same
+// frames converted to 16 bits, and reports how far the 8-bit fits and outputs
+// stray from the 16-bit ones. Outputs may differ by 1 where the 16-bit result
+// rounds the other way when converted back. It exits with 1 if the fits or
+// outputs differ by more than that, or if there are no edges to compare. It
+// fixes left=2 and top=2 unless edges are given. It does not run a plugin, so
+// it takes no host.
+
+static const char usage[] = "usage: EdgeFixerBench Continuity|Reference|Multi|Sample|Precision [width=1920] [height=1080] [frames=2000] [threads=1] [pool=8] [format=yuv420] [bits=8] [host=vs] [filter args...]\n";
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static int get_arg(const VSMap *in, const char *key, int def)
+{
+	int err;
+	int value = (int)mock_vsapi()->propGetInt(in, key, 0, &err);
+	return err ? def : value;
+}
+
+template <class T>
+static void compare_planes(const uint8_t *a, const uint8_t *b, size_t size, double& sum_sqr, double& max_diff)
+{
+	const T *x = reinterpret_cast<const T *>(a);
+	const T *y = reinterpret_cast<const T *>(b);
+
+	for (size_t i = 0; i < size / sizeof(T); ++i) {
+		double d = fabs((double)x[i] - (double)y[i]);
+		sum_sqr += d * d;
+		max_diff = std::max(max_diff, d);
+	}
+}
+
+static int run_sample_error(VSNodeRef *source, const VSFormat *format, int frames, const VSMap *in)
+{
+	const VSAPI *vsapi = mock_vsapi();
+	int left = get_arg(in, "left", 0), top = get_arg(in, "top", 0), right = get_arg(in, "right", 0), bottom = get_arg(in, "bottom", 0);
+	int sample = get_arg(in, "sample", 8);
+	edgefixer_type type = format->bytesPerSample == 2 ? EDGEFIXER_WORD : EDGEFIXER_BYTE;
+	double full_time = 0, sampled_time = 0, sum_sqr = 0, max_diff = 0;
+	size_t lines_samples = 0;
+	std::string error;
+
+	for (int n = 0; n < frames; ++n) {
+		const VSFrameRef *frame = mock_get_frame(source, n, error);
+		int width = vsapi->getFrameWidth(frame, 0);
+		int height = vsapi->getFrameHeight(frame, 0);
+		int stride = vsapi->getStride(frame, 0);
+		std::vector<uint8_t> full(vsapi->getReadPtr(frame, 0), vsapi->getReadPtr(frame, 0) + (size_t)stride * height);
+		std::vector<uint8_t> sampled(full);
+		std::vector<uint8_t> tmp(edgefixer_required_buffer(type, width, height));
+		vsapi->freeFrame(frame);
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		edgefixer_continuity(type, full.data(), stride, width, height, left, top, right, bottom, 0, tmp.data());
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		edgefixer_continuity_sampled(type, sampled.data(), stride, width, height, left, top, right, bottom, sample, tmp.data());
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		full_time += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		sampled_time += std::chrono::duration<double, std::milli>(t2 - t1).count();
+		lines_samples += (size_t)(left + right) * height + (size_t)(top + bottom) * width;
+
+		if (type == EDGEFIXER_WORD)
+			compare_planes<uint16_t>(full.data(), sampled.data(), full.size(), sum_sqr, max_diff);
+		else
+			compare_planes<uint8_t>(full.data(), sampled.data(), full.size(), sum_sqr, max_diff);
+	}
+
+	printf("Sample step %d, %d frames\n", sample, frames);
+	printf("full fit: %.3f ms/frame, sampled fit: %.3f ms/frame\n", full_time / frames, sampled_time / frames);
+	printf("difference from full fit: rms %.4f, max %.0f (over %zu corrected samples per frame)\n",
+	       lines_samples ? sqrt(sum_sqr / lines_samples) : 0.0, max_diff, lines_samples / frames);
+	return 0;
+}
+
+// Bounds for Precision. a and b are stored as float, whose spacing is 6e-8
+// near a slope of 1 and 1.5e-5 near an offset of 255.
+static const double max_slope_error = 1e-6;
+static const double max_offset_error = 1e-5;
+static const int max_sample_error = 1;
+
+static int run_precision(VSNodeRef *source, const VSFormat *format, int frames, const VSMap *in)
+{
+	const VSAPI *vsapi = mock_vsapi();
+	bool edges = vsapi->propNumElements(in, "left") > 0 || vsapi->propNumElements(in, "top") > 0 || vsapi->propNumElements(in, "right") > 0 || vsapi->propNumElements(in, "bottom") > 0;
+	int left = get_arg(in, "left", edges ? 0 : 2), top = get_arg(in, "top", edges ? 0 : 2), right = get_arg(in, "right", 0), bottom = get_arg(in, "bottom", 0);
+	int radius = get_arg(in, "radius", 0);
+	int num_lines = left + top + right + bottom;
+	size_t lines_samples = 0, differing = 0;
+	double max_slope_diff = 0, max_offset_diff = 0;
+	int max_diff = 0;
+	std::string error;
+
+	if (format->bytesPerSample != 1) {
+		fputs("Precision requires bits=8\n", stderr);
+		return 1;
+	}
+
+	for (int n = 0; n < frames; ++n) {
+		const VSFrameRef *frame = mock_get_frame(source, n, error);
+		int width = vsapi->getFrameWidth(frame, 0);
+		int height = vsapi->getFrameHeight(frame, 0);
+		int stride = vsapi->getStride(frame, 0);
+		std::vector<uint8_t> bytes(vsapi->getReadPtr(frame, 0), vsapi->getReadPtr(frame, 0) + (size_t)stride * height);
+		std::vector<uint16_t> words(bytes.size());
+		std::vector<uint8_t> tmp(edgefixer_required_buffer(EDGEFIXER_WORD, width, height));
+		vsapi->freeFrame(frame);
+
+		std::vector<edgefixer_edge_stats> stats8(num_lines), stats16(num_lines);
+
+		for (size_t i = 0; i < bytes.size(); ++i)
+			words[i] = (uint16_t)(bytes[i] << 8);
+
+		// Fits are compared on the unprocessed frame, so each sees the same input.
+		edgefixer_continuity_measure(EDGEFIXER_BYTE, bytes.data(), stride, width, height, left, top, right, bottom, 0, tmp.data(), stats8.data());
+		edgefixer_continuity_measure(EDGEFIXER_WORD, words.data(), stride * 2, width, height, left, top, right, bottom, 0, tmp.data(), stats16.data());
+		for (int i = 0; i < num_lines; ++i) {
+			max_slope_diff = std::max(max_slope_diff, fabs(stats8[i].slope - stats16[i].slope));
+			max_offset_diff = std::max(max_offset_diff, fabs(stats8[i].offset - stats16[i].offset / 256));
+		}
+
+		edgefixer_continuity(EDGEFIXER_BYTE, bytes.data(), stride, width, height, left, top, right, bottom, radius, tmp.data());
+		edgefixer_continuity(EDGEFIXER_WORD, words.data(), stride * 2, width, height, left, top, right, bottom, radius, tmp.data());
+
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			int d = abs((int)bytes[i] - std::min((words[i] + 128) >> 8, 255));
+			differing += d != 0;
+			max_diff = std::max(max_diff, d);
+		}
+		lines_samples += (size_t)(left + right) * height + (size_t)(top + bottom) * width;
+	}
+
+	printf("Precision radius %d, %d frames\n", radius, frames);
+	printf("8-bit fit against 16-bit fit: slope max difference %.3g, offset max difference %.3g\n", max_slope_diff, max_offset_diff);
+	printf("8-bit output against 16-bit output: %zu of %zu corrected samples differ, max %d\n", differing, lines_samples, max_diff);
+
+	if (!num_lines || !lines_samples) {
+		printf("FAIL: no edges were compared\n");
+		return 1;
+	}
+	if (max_slope_diff > max_slope_error || max_offset_diff > max_offset_error || max_diff > max_sample_error) {
+		printf("FAIL: bounds are slope %g, offset %g, sample %d\n", max_slope_error, max_offset_error, max_sample_error);
+		return 1;
+	}
+	printf("PASS\n");
+	return 0;
+}
+
+// Specs for Multi: continuity on the first plane, then the reference on the
+// other planes of the clip.
+static std::vector<int> multi_specs(const VSMap *in, int num_planes)
+{
+	int edges[5] = { get_arg(in, "left", 0), get_arg(in, "top", 0), get_arg(in, "right", 0), get_arg(in, "bottom", 0), get_arg(in, "radius", 0) };
+	std::vector<int> specs;
+
+	for (int i = 0; i < 2; ++i) {
+		specs.push_back(i - 1);
+		specs.insert(specs.end(), edges, edges + 5);
+		specs.push_back(i && num_planes > 1 ? ((1 << num_planes) - 1) & ~1 : 1);
+	}
+	return specs;
+}
+
+// Fetches every frame once, spread over threads workers, through get_frame,
+// which returns false and fills error on failure. Returns the sorted
+// latencies in ms, or nothing if a frame failed.
+template <class GetFrame>
+static std::vector<double> fetch_frames(int frames, int threads, GetFrame get_frame, double& elapsed)
+{
+	std::atomic<int> next(0);
+	std::atomic<bool> failed(false);
+	std::vector<std::vector<double> > latencies(threads);
+	std::vector<std::thread> workers;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (int t = 0; t < threads; ++t) {
+		workers.push_back(std::thread([&, t]() {
+			std::string error;
+			int n;
+
+			while (!failed && (n = next++) < frames) {
+				std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+				bool ok = get_frame(n, error);
+				latencies[t].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+
+				if (!ok) {
+					fprintf(stderr, "frame %d: %s\n", n, error.c_str());
+					failed = true;
+				}
+			}
+		}));
+	}
+	for (size_t t = 0; t < workers.size(); ++t)
+		workers[t].join();
+
+	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<double> all;
+	if (failed)
+		return all;
+	for (size_t t = 0; t < latencies.size(); ++t)
+		all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+	std::sort(all.begin(), all.end());
+	return all;
+}
+
+static void print_results(const char *filter, const std::string& clip, int frames, int threads, const std::vector<double>& all, double elapsed, const MockCounters& counters)
+{
+	printf("%s %s, %d frames, %d threads\n", filter, clip.c_str(), frames, threads);
+	printf("throughput: %.1f fps\n", frames / elapsed);
+	printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", percentile(all, 50), percentile(all, 90), percentile(all, 99), all.back());
+	printf("per frame: %.2f frames allocated, %.2f planes allocated, %.2f planes copied, %.0f bytes copied\n",
+	       (double)counters.frames_allocated / frames, (double)counters.planes_allocated / frames,
+	       (double)counters.planes_copied / frames, (double)counters.bytes_copied / frames);
+}
+
+// Appends the filter arguments in in as named AviSynth arguments, leaving out
+// skip. names must outlive args, as AVSValue does not copy strings.
+static void avs_args(const VSMap *in, const char *skip, std::vector<AVSValue>& args, std::vector<const char *>& names)
+{
+	static const char *const bools[] = { "passthrough", "measure", "fields", "frameprops" };
+	const VSAPI *vsapi = mock_vsapi();
+
+	for (int i = 0; i < vsapi->propNumKeys(in); ++i) {
+		const char *key = vsapi->propGetKey(in, i);
+		int value = get_arg(in, key, 0);
+		bool flag = false;
+
+		if (skip && !strcmp(key, skip))
+			continue;
+		for (size_t j = 0; j < sizeof(bools) / sizeof(bools[0]); ++j)
+			flag |= !strcmp(key, bools[j]);
+		args.push_back(flag ? AVSValue(value != 0) : AVSValue(value));
+		names.push_back(key);
+	}
+}
+
+static PClip avs_invoke(const char *name, const std::vector<AVSValue>& args, const std::vector<const char *>& names)
+{
+	return mock_avs_env()->Invoke(name, AVSValue(args.data(), (int)args.size()), names.data()).AsClip();
+}
+
+static int run_avs_sample(PClip source, int frames, const VSMap *in)
+{
+	IScriptEnvironment *env = mock_avs_env();
+	const VideoInfo& vi = source->GetVideoInfo();
+	int left = get_arg(in, "left", 0), top = get_arg(in, "top", 0), right = get_arg(in, "right", 0), bottom = get_arg(in, "bottom", 0);
+	int sample = get_arg(in, "sample", 8);
+	int plane = vi.IsRGB() ? PLANAR_R : PLANAR_Y;
+	double full_time = 0, sampled_time = 0, sum_sqr = 0, max_diff = 0;
+	size_t lines_samples = 0;
+	PClip clips[2];
+
+	for (int i = 0; i < 2; ++i) {
+		std::vector<AVSValue> args(1, source);
+		std::vector<const char *> names(1, (const char *)0);
+		avs_args(in, "sample", args, names);
+		args.push_back(i ? sample : 1);
+		names.push_back("sample");
+		clips[i] = avs_invoke("ContinuityFixer", args, names);
+	}
+
+	for (int n = 0; n < frames; ++n) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		PVideoFrame full = clips[0]->GetFrame(n, env);
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		PVideoFrame sampled = clips[1]->GetFrame(n, env);
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		full_time += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		sampled_time += std::chrono::duration<double, std::milli>(t2 - t1).count();
+		lines_samples += (size_t)(left + right) * vi.height + (size_t)(top + bottom) * vi.width;
+
+		for (int y = 0; y < full->GetHeight(plane); ++y) {
+			const uint8_t *a = full->GetReadPtr(plane) + (ptrdiff_t)y * full->GetPitch(plane);
+			const uint8_t *b = sampled->GetReadPtr(plane) + (ptrdiff_t)y * sampled->GetPitch(plane);
+			if (vi.ComponentSize() == 2)
+				compare_planes<uint16_t>(a, b, full->GetRowSize(plane), sum_sqr, max_diff);
+			else
+				compare_planes<uint8_t>(a, b, full->GetRowSize(plane), sum_sqr, max_diff);
+		}
+	}
+
+	printf("ContinuityFixer sample %d, %d frames\n", sample, frames);
+	printf("full fit: %.3f ms/frame, sampled fit: %.3f ms/frame\n", full_time / frames, sampled_time / frames);
+	printf("difference from full fit: rms %.4f, max %.0f (over %zu corrected samples per frame)\n",
+	       lines_samples ? sqrt(sum_sqr / lines_samples) : 0.0, max_diff, lines_samples / frames);
+	return 0;
+}
+
+// Runs the AviSynth counterpart of filter through avsplugin.cpp.
+static int run_avs(const char *filter, const std::string& clip, const VSFormat *format, int width, int height, int frames, int threads, int pool, const VSMap *in)
+{
+	IScriptEnvironment *env = mock_avs_env();
+	const char *name = !strcmp(filter, "Continuity") ? "ContinuityFixer" : !strcmp(filter, "Reference") ? "ReferenceFixer" : "MultiFixer";
+
+	mock_avs_load_plugin(AvisynthPluginInit3);
+
+	try {
+		PClip source = mock_avs_source(format, width, height, frames, pool, true);
+		if (!strcmp(filter, "Sample"))
+			return run_avs_sample(source, frames, in);
+
+		std::vector<AVSValue> args(1, source);
+		std::vector<const char *> names(1, (const char *)0);
+		std::string specs;
+
+		if (strcmp(filter, "Continuity")) {
+			if (!strcmp(filter, "Multi")) {
+				std::vector<int> values = multi_specs(in, format->numPlanes);
+				for (size_t i = 0; i < values.size(); ++i)
+					specs += std::to_string(values[i]) + " ";
+				args.push_back(specs.c_str());
+				names.push_back(0);
+			}
+			args.push_back(mock_avs_source(format, width, height, frames, pool, false));
+			names.push_back(0);
+		}
+		if (strcmp(filter, "Multi"))
+			avs_args(in, 0, args, names);
+
+		PClip node = avs_invoke(name, args, names);
+
+		mock_avs_reset_counters();
+		double elapsed;
+		std::vector<double> all = fetch_frames(frames, threads, [&](int n, std::string& error) {
+			try {
+				node->GetFrame(n, env);
+				return true;
+			} catch (const AvisynthError& e) {
+				error = e.msg;
+				return false;
+			}
+		}, elapsed);
+		MockCounters counters = mock_avs_counters();
+
+		if (all.empty())
+			return 1;
+		print_results(name, clip, frames, threads, all, elapsed, counters);
+		return 0;
+	} catch (const AvisynthError& e) {
+		fprintf(stderr, "%s\n", e.msg);
+		return 1;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2 || (strcmp(argv[1], "Continuity") && strcmp(argv[1], "Reference") && strcmp(argv[1], "Multi") && strcmp(argv[1], "Sample") && strcmp(argv[1], "Precision"))) {
+		fputs(usage, stderr);
+		return 1;
+	}
+
+	const VSAPI *vsapi = mock_vsapi();
+	const char *filter = argv[1];
+	std::string format_name = "yuv420", host = "vs";
+	int width = 1920, height = 1080, frames = 2000, threads = 1, pool = 8, bits = 8;
+	VSMap *in = vsapi->createMap();
+
+	for (int i = 2; i < argc; ++i) {
+		const char *eq = strchr(argv[i], '=');
+		if (!eq) {
+			fputs(usage, stderr);
+			return 1;
+		}
+
+		std::string key(argv[i], eq - argv[i]);
+		const char *value = eq + 1;
+
+		if (key == "width") width = atoi(value);
+		else if (key == "height") height = atoi(value);
+		else if (key == "frames") frames = atoi(value);
+		else if (key == "threads") threads = atoi(value);
+		else if (key == "pool") pool = atoi(value);
+		else if (key == "bits") bits = atoi(value);
+		else if (key == "format") format_name = value;
+		else if (key == "host") host = value;
+		else vsapi->propSetInt(in, key.c_str(), atoi(value), paReplace);
+	}
+
+	int ssw = 0, ssh = 0, family = cmYUV;
+	if (format_name == "gray") family = cmGray;
+	else if (format_name == "rgb") family = cmRGB;
+	else if (format_name == "yuv420") ssw = ssh = 1;
+	else if (format_name == "yuv422") ssw = 1;
+	else if (format_name != "yuv444") {
+		fprintf(stderr, "unknown format %s\n", format_name.c_str());
+		return 1;
+	}
+	if (width <= 0 || height <= 0 || frames <= 0 || threads <= 0 || pool <= 0 || bits < 8 || bits > 16 || (host != "vs" && host != "avs")) {
+		fputs(usage, stderr);
+		return 1;
+	}
+
+	const VSFormat *format = vsapi->registerFormat(family, stInteger, bits, ssw, ssh, mock_core());
+	std::string clip = std::to_string(width) + "x" + std::to_string(height) + " " + format_name + " " + std::to_string(bits) + "-bit";
+
+	if (host == "avs") {
+		if (!strcmp(filter, "Precision")) {
+			fputs("Precision does not take a host\n", stderr);
+			return 1;
+		}
+		int ret = run_avs(filter, clip, format, width, height, frames, threads, pool, in);
+		vsapi->freeMap(in);
+		return ret;
+	}
+
+	mock_load_plugin(VapourSynthPluginInit);
+
+	VSNodeRef *source = mock_source(format, width, height, frames, pool, true);
+	if (!strcmp(filter, "Sample")) {
+		int ret = run_sample_error(source, format, frames, in);
+		vsapi->freeNode(source);
+		vsapi->freeMap(in);
+		return ret;
+	}
+	if (!strcmp(filter, "Precision")) {
+		int ret = run_precision(source, format, frames, in);
+		vsapi->freeNode(source);
+		vsapi->freeMap(in);
+		return ret;
+	}
+	vsapi->propSetNode(in, "clip", source, paReplace);
+	vsapi->freeNode(source);
+	if (!strcmp(filter, "Reference") || !strcmp(filter, "Multi")) {
+		VSNodeRef *ref = mock_source(format, width, height, frames, pool, false);
+		vsapi->propSetNode(in, strcmp(filter, "Multi") ? "ref" : "refs", ref, paReplace);
+		vsapi->freeNode(ref);
+	}
+	if (!strcmp(filter, "Multi")) {
+		std::vector<int> specs = multi_specs(in, format->numPlanes);
+		const char *edges[] = { "left", "top", "right", "bottom", "radius" };
+		for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i)
+			vsapi->propDeleteKey(in, edges[i]);
+		for (size_t i = 0; i < specs.size(); ++i)
+			vsapi->propSetInt(in, "specs", specs[i], paAppend);
+	}
+
+	VSMap *out = mock_invoke(filter, in);
+	vsapi->freeMap(in);
+	if (vsapi->getError(out)) {
+		fprintf(stderr, "%s\n", vsapi->getError(out));
+		return 1;
+	}
+
+	VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, 0);
+	vsapi->freeMap(out);
+
+	mock_reset_counters();
+	double elapsed;
+	std::vector<double> all = fetch_frames(frames, threads, [&](int n, std::string& error) {
+		const VSFrameRef *frame = mock_get_frame(node, n, error);
+		vsapi->freeFrame(frame);
+		return frame != 0;
+	}, elapsed);
+	MockCounters counters = mock_counters();
+	vsapi->freeNode(node);
+
+	if (all.empty())
+		return 1;
+	print_results(filter, clip, frames, threads, all, elapsed, counters);
+	return 0;
+}
@@ -0,0 +1,1098 @@
+#include <atomic>
+#include <ctype.h>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "mockavs.h"
+
+// Backs every plane of a frame, like VideoFrameBuffer. Frames made by
+// Subframe and MakePropertyWritable share it, which makes them unwritable.
+struct MockAvsBuffer {
+	std::vector<uint8_t> data;
+	long refs;
+
+	MockAvsBuffer() : refs(0) {}
+	~MockAvsBuffer() { mock_give_buffer(data); }
+};
+
+struct MockAvsEntry {
+	char type;
+	std::vector<int64_t> ints;
+	std::vector<double> floats;
+	std::vector<std::string> data;
+	std::vector<PClip> clips;
+	std::vector<PVideoFrame> frames;
+};
+
+struct AVSMap {
+	std::map<std::string, MockAvsEntry> entries;
+};
+
+struct MockAvsFunction {
+	std::string params;
+	IScriptEnvironment::ApplyFunc apply;
+	void *user_data;
+};
+
+// AVSValue keeps its members private. They are reached through this struct
+// of the same layout, which avisynth_c.h publishes as AVS_Value.
+struct MockValue {
+	short type;
+	short array_size;
+	union {
+		IClip *clip;
+		bool boolean;
+		int integer;
+		float floating_pt;
+		const char *string;
+		const AVSValue *array;
+		void *pointer;
+	};
+};
+
+// MakePropertyWritable, which the plugin calls, arrived in interface version
+// 9. The environment also implements the version 11 additions.
+static_assert(AVISYNTH_INTERFACE_VERSION >= 9, "mockavs needs avisynth.h from AviSynth+ 3.7.1 or later");
+static_assert(sizeof(MockValue) == sizeof(AVSValue), "AVSValue does not have the layout of AVS_Value");
+static_assert(sizeof(PClip) == sizeof(IClip *), "PClip holds more than its pointer");
+static_assert(sizeof(PVideoFrame) == sizeof(VideoFrame *), "PVideoFrame holds more than its pointer");
+
+namespace {
+
+std::atomic<uint64_t> g_frames_allocated(0);
+std::atomic<uint64_t> g_planes_allocated(0);
+std::atomic<uint64_t> g_planes_copied(0);
+std::atomic<uint64_t> g_bytes_copied(0);
+
+// Guards the reference counts of clips, frames and buffers.
+std::mutex g_ref_mutex;
+std::map<IClip *, long> g_clip_refs;
+
+AVS_Linkage g_linkage;
+
+void add_ref(IClip *clip)
+{
+	if (clip) {
+		std::lock_guard<std::mutex> lock(g_ref_mutex);
+		++g_clip_refs[clip];
+	}
+}
+
+// Deletes the clip with its last reference, outside the lock, as its
+// destructor releases the clips it holds.
+void release(IClip *clip)
+{
+	if (!clip)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(g_ref_mutex);
+		std::map<IClip *, long>::iterator it = g_clip_refs.find(clip);
+		if (--it->second)
+			return;
+		g_clip_refs.erase(it);
+	}
+	delete clip;
+}
+
+IClip *&pointer_of(PClip *clip) { return *reinterpret_cast<IClip **>(clip); }
+IClip *pointer_of(const PClip *clip) { return *reinterpret_cast<IClip *const *>(clip); }
+VideoFrame *&pointer_of(PVideoFrame *frame) { return *reinterpret_cast<VideoFrame **>(frame); }
+VideoFrame *pointer_of(const PVideoFrame *frame) { return *reinterpret_cast<VideoFrame *const *>(frame); }
+MockValue& value_of(AVSValue *value) { return *reinterpret_cast<MockValue *>(value); }
+const MockValue& value_of(const AVSValue *value) { return *reinterpret_cast<const MockValue *>(value); }
+
+int plane_slot(int plane)
+{
+	switch (plane) {
+	case PLANAR_U:
+	case PLANAR_B:
+		return 1;
+	case PLANAR_V:
+	case PLANAR_R:
+		return 2;
+	case PLANAR_A:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+bool same_name(const char *a, const char *b)
+{
+	for (; *a && *b; ++a, ++b) {
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+			return false;
+	}
+	return *a == *b;
+}
+
+struct MockParam {
+	std::string name;
+	char type;
+	bool array;
+};
+
+// Splits an AddFunction parameter string such as "c[left]i[zones]s".
+std::vector<MockParam> parse_params(const char *params)
+{
+	std::vector<MockParam> result;
+	while (*params) {
+		MockParam p;
+		if (*params == '[') {
+			const char *end = strchr(params, ']');
+			p.name.assign(params + 1, end);
+			params = end + 1;
+		}
+		p.type = *params++;
+		p.array = *params == '*' || *params == '+';
+		if (p.array)
+			++params;
+		result.push_back(p);
+	}
+	return result;
+}
+
+bool matches(char type, const AVSValue& value)
+{
+	switch (type) {
+	case 'c': return value.IsClip();
+	case 'i': return value.IsInt();
+	case 'f': return value.IsFloat();
+	case 'b': return value.IsBool();
+	case 's': return value.IsString();
+	default: return true;
+	}
+}
+
+} // namespace
+
+// VideoFrame befriends ScriptEnvironment, so everything touching the members
+// of frames lives here. Frames are never constructed: their storage is
+// allocated and filled in, and the plugin only reaches them through the
+// linkage entries below.
+class ScriptEnvironment: public IScriptEnvironment {
+	std::mutex m_mutex;
+	std::map<std::string, MockAvsFunction> m_functions;
+	std::list<std::string> m_strings;
+
+	void Unsupported(const char *name)
+	{
+		ThrowError("mockavs: %s is not supported", name);
+	}
+
+	static MockAvsBuffer *Buffer(const VideoFrame *f)
+	{
+		return reinterpret_cast<MockAvsBuffer *>(f->vfb);
+	}
+
+	static VideoFrame *NewFrame(MockAvsBuffer *buffer, const AVSMap *props)
+	{
+		VideoFrame *f = static_cast<VideoFrame *>(::operator new(sizeof(VideoFrame)));
+		f->refcount = 0;
+		f->vfb = reinterpret_cast<VideoFrameBuffer *>(buffer);
+		f->offset = f->pitch = f->row_size = f->height = 0;
+		f->offsetU = f->offsetV = f->pitchUV = f->row_sizeUV = f->heightUV = 0;
+		f->offsetA = f->pitchA = f->row_sizeA = 0;
+		f->properties = props ? new AVSMap(*props) : new AVSMap;
+
+		std::lock_guard<std::mutex> lock(g_ref_mutex);
+		++buffer->refs;
+		return f;
+	}
+
+	// A new frame on the buffer of src, with the same planes and properties.
+	static VideoFrame *ShareFrame(const VideoFrame *src)
+	{
+		VideoFrame *f = NewFrame(Buffer(src), src->properties);
+		f->offset = src->offset;
+		f->pitch = src->pitch;
+		f->row_size = src->row_size;
+		f->height = src->height;
+		f->offsetU = src->offsetU;
+		f->offsetV = src->offsetV;
+		f->pitchUV = src->pitchUV;
+		f->row_sizeUV = src->row_sizeUV;
+		f->heightUV = src->heightUV;
+		f->offsetA = src->offsetA;
+		f->pitchA = src->pitchA;
+		f->row_sizeA = src->row_sizeA;
+		return f;
+	}
+
+	// Lays out luma, chroma and alpha one after another in a new buffer.
+	static VideoFrame *AllocateFrame(int row_size, int height, int row_size_uv, int height_uv, bool alpha, int align, const AVSMap *props)
+	{
+		align = align > 0 ? align : FRAME_ALIGN;
+		int pitch = (row_size + align - 1) / align * align;
+		int pitch_uv = (row_size_uv + align - 1) / align * align;
+		size_t size = (size_t)pitch * height;
+		size_t size_uv = (size_t)pitch_uv * height_uv;
+
+		MockAvsBuffer *buffer = new MockAvsBuffer;
+		buffer->data = mock_take_buffer(size + 2 * size_uv + (alpha ? size : 0));
+
+		VideoFrame *f = NewFrame(buffer, props);
+		f->pitch = pitch;
+		f->row_size = row_size;
+		f->height = height;
+		f->offsetU = (int)size;
+		f->offsetV = (int)(size + size_uv);
+		f->pitchUV = pitch_uv;
+		f->row_sizeUV = row_size_uv;
+		f->heightUV = height_uv;
+		if (alpha) {
+			f->offsetA = (int)(size + 2 * size_uv);
+			f->pitchA = pitch;
+			f->row_sizeA = row_size;
+		}
+
+		++g_frames_allocated;
+		g_planes_allocated += 1 + (row_size_uv ? 2 : 0) + (alpha ? 1 : 0);
+		return f;
+	}
+
+public:
+	static void AddRef(VideoFrame *f)
+	{
+		if (f) {
+			std::lock_guard<std::mutex> lock(g_ref_mutex);
+			++f->refcount;
+		}
+	}
+
+	// Frees the frame with its last reference, and the buffer with the last
+	// frame on it, outside the lock, as the properties may hold frames too.
+	static void Release(VideoFrame *f)
+	{
+		if (!f)
+			return;
+
+		MockAvsBuffer *buffer = 0;
+		{
+			std::lock_guard<std::mutex> lock(g_ref_mutex);
+			if (--f->refcount)
+				return;
+			if (!--Buffer(f)->refs)
+				buffer = Buffer(f);
+		}
+		delete buffer;
+		delete f->properties;
+		::operator delete(f);
+	}
+
+	static bool IsWritable(const VideoFrame *f)
+	{
+		std::lock_guard<std::mutex> lock(g_ref_mutex);
+		return f->refcount == 1 && Buffer(f)->refs == 1;
+	}
+
+	static int Offset(const VideoFrame *f, int plane)
+	{
+		static const int VideoFrame::*const offsets[4] = { &VideoFrame::offset, &VideoFrame::offsetU, &VideoFrame::offsetV, &VideoFrame::offsetA };
+		return f->*offsets[plane_slot(plane)];
+	}
+
+	static int Pitch(const VideoFrame *f, int plane)
+	{
+		int slot = plane_slot(plane);
+		return slot == 3 ? f->pitchA : slot ? f->pitchUV : f->pitch;
+	}
+
+	static int RowSize(const VideoFrame *f, int plane)
+	{
+		int slot = plane_slot(plane);
+		return slot == 3 ? (f->pitchA ? f->row_sizeA : 0) : slot ? (f->pitchUV ? f->row_sizeUV : 0) : f->row_size;
+	}
+
+	static int Height(const VideoFrame *f, int plane)
+	{
+		int slot = plane_slot(plane);
+		return slot == 3 ? (f->pitchA ? f->height : 0) : slot ? (f->pitchUV ? f->heightUV : 0) : f->height;
+	}
+
+	static BYTE *Data(const VideoFrame *f, int plane)
+	{
+		return Buffer(f)->data.data() + Offset(f, plane);
+	}
+
+	/* IScriptEnvironment */
+
+	int __stdcall GetCPUFlags() { return 0; }
+
+	char *__stdcall SaveString(const char *s, int length)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_strings.push_back(length < 0 ? std::string(s) : std::string(s, length));
+		return &m_strings.back()[0];
+	}
+
+	char *Sprintf(const char *fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		char *s = VSprintf(fmt, args);
+		va_end(args);
+		return s;
+	}
+
+	char *__stdcall VSprintf(const char *fmt, va_list val)
+	{
+		char buf[1024];
+		vsnprintf(buf, sizeof(buf), fmt, val);
+		return SaveString(buf, -1);
+	}
+
+	void ThrowError(const char *fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		char *msg = VSprintf(fmt, args);
+		va_end(args);
+		throw AvisynthError(msg);
+	}
+
+	void __stdcall AddFunction(const char *name, const char *params, ApplyFunc apply, void *user_data)
+	{
+		MockAvsFunction f = { params, apply, user_data };
+		m_functions[name] = f;
+	}
+
+	bool __stdcall FunctionExists(const char *name)
+	{
+		return m_functions.count(name) != 0;
+	}
+
+	// Binds positional arguments in order, an array parameter taking all
+	// that remain, and named arguments by name, as the script parser does.
+	AVSValue __stdcall Invoke(const char *name, const AVSValue args, const char *const *arg_names)
+	{
+		std::map<std::string, MockAvsFunction>::const_iterator it = m_functions.find(name);
+		if (it == m_functions.end())
+			throw NotFound();
+
+		std::vector<MockParam> params = parse_params(it->second.params.c_str());
+		std::vector<AVSValue> values(params.size());
+		std::vector<AVSValue> array;
+		int count = args.IsArray() ? args.ArraySize() : 1;
+		size_t next = 0;
+
+		for (int i = 0; i < count; ++i) {
+			const AVSValue& arg = args.IsArray() ? args[i] : args;
+			size_t index = 0;
+
+			if (arg_names && arg_names[i]) {
+				while (index < params.size() && !same_name(params[index].name.c_str(), arg_names[i]))
+					++index;
+				if (index == params.size())
+					ThrowError("%s does not have a named argument \"%s\"", name, arg_names[i]);
+			} else if (next < params.size() && params[next].array) {
+				if (!matches(params[next].type, arg))
+					ThrowError("Invalid arguments to function \"%s\"", name);
+				array.push_back(arg);
+				continue;
+			} else {
+				if (next == params.size())
+					ThrowError("Invalid arguments to function \"%s\"", name);
+				index = next++;
+			}
+
+			if (!matches(params[index].type, arg))
+				ThrowError("Invalid arguments to function \"%s\"", name);
+			values[index] = arg;
+		}
+		if (next < params.size() && params[next].array)
+			values[next++] = AVSValue(array.data(), (int)array.size());
+		for (size_t i = next; i < params.size(); ++i) {
+			if (params[i].name.empty())
+				ThrowError("Invalid arguments to function \"%s\"", name);
+		}
+
+		return it->second.apply(AVSValue(values.data(), (int)values.size()), it->second.user_data, this);
+	}
+
+	AVSValue __stdcall GetVar(const char *name) { throw NotFound(); }
+	bool __stdcall SetVar(const char *name, const AVSValue& val) { Unsupported("SetVar"); return false; }
+	bool __stdcall SetGlobalVar(const char *name, const AVSValue& val) { Unsupported("SetGlobalVar"); return false; }
+	void __stdcall PushContext(int level) {}
+	void __stdcall PopContext() {}
+
+	PVideoFrame __stdcall NewVideoFrame(const VideoInfo& vi, int align)
+	{
+		if (!vi.IsPlanar())
+			ThrowError("mockavs: only planar formats are supported");
+
+		int size = vi.ComponentSize();
+		bool chroma = vi.NumComponents() > 1;
+		int ssw = chroma && !vi.IsRGB() ? vi.GetPlaneWidthSubsampling(PLANAR_U) : 0;
+		int ssh = chroma && !vi.IsRGB() ? vi.GetPlaneHeightSubsampling(PLANAR_U) : 0;
+		return AllocateFrame(vi.width * size, vi.height, chroma ? (vi.width >> ssw) * size : 0, chroma ? vi.height >> ssh : 0,
+		                     vi.NumComponents() == 4, align, 0);
+	}
+
+	// Copies a frame that is shared, or whose buffer is, into a new one.
+	bool __stdcall MakeWritable(PVideoFrame *pvf)
+	{
+		const VideoFrame *src = pointer_of(pvf);
+		if (IsWritable(src))
+			return false;
+
+		PVideoFrame dst = AllocateFrame(src->row_size, src->height, src->pitchUV ? src->row_sizeUV : 0, src->pitchUV ? src->heightUV : 0,
+		                                src->pitchA != 0, FRAME_ALIGN, src->properties);
+		static const int planes[4] = { PLANAR_Y, PLANAR_U, PLANAR_V, PLANAR_A };
+		for (int i = 0; i < 4; ++i) {
+			int row_size = RowSize(src, planes[i]);
+			if (!row_size)
+				continue;
+			BitBlt(Data(pointer_of(&dst), planes[i]), Pitch(pointer_of(&dst), planes[i]), Data(src, planes[i]), Pitch(src, planes[i]), row_size, Height(src, planes[i]));
+			++g_planes_copied;
+			g_bytes_copied += (uint64_t)row_size * Height(src, planes[i]);
+		}
+		*pvf = dst;
+		return true;
+	}
+
+	void __stdcall BitBlt(BYTE *dstp, int dst_pitch, const BYTE *srcp, int src_pitch, int row_size, int height)
+	{
+		for (int y = 0; y < height; ++y)
+			memcpy(dstp + (ptrdiff_t)y * dst_pitch, srcp + (ptrdiff_t)y * src_pitch, row_size);
+	}
+
+	void __stdcall AtExit(ShutdownFunc function, void *user_data) {}
+
+	void __stdcall CheckVersion(int version)
+	{
+		if (version > AVISYNTH_INTERFACE_VERSION)
+			ThrowError("Plugin was designed for a later version of AviSynth (%d)", version);
+	}
+
+	PVideoFrame __stdcall Subframe(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height)
+	{
+		VideoFrame *f = ShareFrame(pointer_of(&src));
+		f->offset += rel_offset;
+		f->pitch = new_pitch;
+		f->row_size = new_row_size;
+		f->height = new_height;
+		f->pitchUV = f->row_sizeUV = f->heightUV = 0;
+		f->pitchA = f->row_sizeA = 0;
+		++g_frames_allocated;
+		return f;
+	}
+
+	int __stdcall SetMemoryMax(int mem) { return 0; }
+	int __stdcall SetWorkingDir(const char *newdir) { return -1; }
+	void *__stdcall ManageCache(int key, void *data) { return 0; }
+	bool __stdcall PlanarChromaAlignment(PlanarChromaAlignmentMode key) { return true; }
+
+	PVideoFrame __stdcall SubframePlanar(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV)
+	{
+		return SubframePlanarA(src, rel_offset, new_pitch, new_row_size, new_height, rel_offsetU, rel_offsetV, new_pitchUV, 0);
+	}
+
+	void __stdcall DeleteScriptEnvironment() {}
+	void __stdcall ApplyMessage(PVideoFrame *frame, const VideoInfo& vi, const char *message, int size, int textcolor, int halocolor, int bgcolor) { Unsupported("ApplyMessage"); }
+	const AVS_Linkage *__stdcall GetAVSLinkage() { return &g_linkage; }
+	AVSValue __stdcall GetVarDef(const char *name, const AVSValue& def) { return def; }
+
+	// Chroma sizes follow the luma size, as in the core.
+	PVideoFrame __stdcall SubframePlanarA(PVideoFrame src, int rel_offset, int new_pitch, int new_row_size, int new_height, int rel_offsetU, int rel_offsetV, int new_pitchUV, int rel_offsetA)
+	{
+		const VideoFrame *s = pointer_of(&src);
+		VideoFrame *f = ShareFrame(s);
+		f->offset += rel_offset;
+		f->pitch = new_pitch;
+		f->row_size = new_row_size;
+		f->height = new_height;
+		f->offsetU += rel_offsetU;
+		f->offsetV += rel_offsetV;
+		f->pitchUV = new_pitchUV;
+		f->row_sizeUV = s->row_size ? (int)((int64_t)new_row_size * s->row_sizeUV / s->row_size) : 0;
+		f->heightUV = s->height ? (int)((int64_t)new_height * s->heightUV / s->height) : 0;
+		if (s->pitchA) {
+			f->offsetA += rel_offsetA;
+			f->pitchA = new_pitch;
+			f->row_sizeA = new_row_size;
+		}
+		++g_frames_allocated;
+		return f;
+	}
+
+	void __stdcall copyFrameProps(const PVideoFrame& src, PVideoFrame& dst)
+	{
+		*pointer_of(&dst)->properties = *pointer_of(&src)->properties;
+	}
+
+	const AVSMap *__stdcall getFramePropsRO(const PVideoFrame& frame)
+	{
+		return pointer_of(&frame)->properties;
+	}
+
+	// Unlike the core, refuses a frame held elsewhere, so that a missing
+	// MakePropertyWritable shows up here.
+	AVSMap *__stdcall getFramePropsRW(PVideoFrame& frame)
+	{
+		VideoFrame *f = pointer_of(&frame);
+		long refs;
+		{
+			std::lock_guard<std::mutex> lock(g_ref_mutex);
+			refs = f->refcount;
+		}
+		if (refs != 1)
+			ThrowError("mockavs: getFramePropsRW on a frame with %ld references", refs);
+		return f->properties;
+	}
+
+	int __stdcall propNumKeys(const AVSMap *map) { return (int)map->entries.size(); }
+
+	const char *__stdcall propGetKey(const AVSMap *map, int index)
+	{
+		if (index < 0 || (size_t)index >= map->entries.size())
+			ThrowError("propGetKey: index %d out of range", index);
+		std::map<std::string, MockAvsEntry>::const_iterator it = map->entries.begin();
+		std::advance(it, index);
+		return it->first.c_str();
+	}
+
+	static size_t Size(const MockAvsEntry& e)
+	{
+		return e.type == PROPTYPE_INT ? e.ints.size() : e.type == PROPTYPE_FLOAT ? e.floats.size() : e.type == PROPTYPE_DATA ? e.data.size() :
+		       e.type == PROPTYPE_CLIP ? e.clips.size() : e.frames.size();
+	}
+
+	int __stdcall propNumElements(const AVSMap *map, const char *key)
+	{
+		std::map<std::string, MockAvsEntry>::const_iterator it = map->entries.find(key);
+		return it == map->entries.end() ? -1 : (int)Size(it->second);
+	}
+
+	char __stdcall propGetType(const AVSMap *map, const char *key)
+	{
+		std::map<std::string, MockAvsEntry>::const_iterator it = map->entries.find(key);
+		return it == map->entries.end() ? PROPTYPE_UNSET : it->second.type;
+	}
+
+	const MockAvsEntry *Find(const AVSMap *map, const char *key, char type, int index, int *error)
+	{
+		std::map<std::string, MockAvsEntry>::const_iterator it = map->entries.find(key);
+		int err = 0;
+
+		if (it == map->entries.end())
+			err = GETPROPERROR_UNSET;
+		else if (it->second.type != type)
+			err = GETPROPERROR_TYPE;
+		else if (index < 0 || (size_t)index >= Size(it->second))
+			err = GETPROPERROR_INDEX;
+
+		if (error)
+			*error = err;
+		else if (err)
+			ThrowError("mockavs: cannot read property %s", key);
+		return err ? 0 : &it->second;
+	}
+
+	MockAvsEntry *Set(AVSMap *map, const char *key, char type, int append)
+	{
+		MockAvsEntry& e = map->entries[key];
+		if (append == PROPAPPENDMODE_REPLACE || e.type != type) {
+			e = MockAvsEntry();
+			e.type = type;
+		}
+		return &e;
+	}
+
+	int64_t __stdcall propGetInt(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_INT, index, error);
+		return e ? e->ints[index] : 0;
+	}
+
+	double __stdcall propGetFloat(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_FLOAT, index, error);
+		return e ? e->floats[index] : 0;
+	}
+
+	const char *__stdcall propGetData(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_DATA, index, error);
+		return e ? e->data[index].c_str() : 0;
+	}
+
+	int __stdcall propGetDataSize(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_DATA, index, error);
+		return e ? (int)e->data[index].size() : 0;
+	}
+
+	PClip __stdcall propGetClip(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_CLIP, index, error);
+		return e ? e->clips[index] : PClip();
+	}
+
+	const PVideoFrame __stdcall propGetFrame(const AVSMap *map, const char *key, int index, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_FRAME, index, error);
+		return e ? e->frames[index] : PVideoFrame();
+	}
+
+	int __stdcall propDeleteKey(AVSMap *map, const char *key) { return (int)map->entries.erase(key); }
+
+	int __stdcall propSetInt(AVSMap *map, const char *key, int64_t i, int append) { Set(map, key, PROPTYPE_INT, append)->ints.push_back(i); return 0; }
+	int __stdcall propSetFloat(AVSMap *map, const char *key, double d, int append) { Set(map, key, PROPTYPE_FLOAT, append)->floats.push_back(d); return 0; }
+
+	int __stdcall propSetData(AVSMap *map, const char *key, const char *d, int length, int append)
+	{
+		Set(map, key, PROPTYPE_DATA, append)->data.push_back(length < 0 ? std::string(d) : std::string(d, length));
+		return 0;
+	}
+
+	int __stdcall propSetClip(AVSMap *map, const char *key, PClip& clip, int append) { Set(map, key, PROPTYPE_CLIP, append)->clips.push_back(clip); return 0; }
+	int __stdcall propSetFrame(AVSMap *map, const char *key, const PVideoFrame& frame, int append) { Set(map, key, PROPTYPE_FRAME, append)->frames.push_back(frame); return 0; }
+
+	const int64_t *__stdcall propGetIntArray(const AVSMap *map, const char *key, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_INT, 0, error);
+		return e ? e->ints.data() : 0;
+	}
+
+	const double *__stdcall propGetFloatArray(const AVSMap *map, const char *key, int *error)
+	{
+		const MockAvsEntry *e = Find(map, key, PROPTYPE_FLOAT, 0, error);
+		return e ? e->floats.data() : 0;
+	}
+
+	int __stdcall propSetIntArray(AVSMap *map, const char *key, const int64_t *i, int size) { Set(map, key, PROPTYPE_INT, PROPAPPENDMODE_REPLACE)->ints.assign(i, i + size); return 0; }
+	int __stdcall propSetFloatArray(AVSMap *map, const char *key, const double *d, int size) { Set(map, key, PROPTYPE_FLOAT, PROPAPPENDMODE_REPLACE)->floats.assign(d, d + size); return 0; }
+
+	AVSMap *__stdcall createMap() { return new AVSMap; }
+	void __stdcall freeMap(AVSMap *map) { delete map; }
+	void __stdcall clearMap(AVSMap *map) { map->entries.clear(); }
+
+	PVideoFrame __stdcall NewVideoFrameP(const VideoInfo& vi, const PVideoFrame *prop_src, int align)
+	{
+		PVideoFrame frame = NewVideoFrame(vi, align);
+		if (prop_src)
+			copyFrameProps(*prop_src, frame);
+		return frame;
+	}
+
+	size_t __stdcall GetEnvProperty(AvsEnvProperty prop) { return 0; }
+	void *__stdcall Allocate(size_t nBytes, size_t alignment, AvsAllocType type) { Unsupported("Allocate"); return 0; }
+	void __stdcall Free(void *ptr) { Unsupported("Free"); }
+	bool __stdcall GetVarTry(const char *name, AVSValue *val) const { return false; }
+	bool __stdcall GetVarBool(const char *name, bool def) const { return def; }
+	int __stdcall GetVarInt(const char *name, int def) const { return def; }
+	double __stdcall GetVarDouble(const char *name, double def) const { return def; }
+	const char *__stdcall GetVarString(const char *name, const char *def) const { return def; }
+	int64_t __stdcall GetVarLong(const char *name, int64_t def) const { return def; }
+
+	bool __stdcall InvokeTry(AVSValue *result, const char *name, const AVSValue& args, const char *const *arg_names)
+	{
+		if (!FunctionExists(name))
+			return false;
+		*result = Invoke(name, args, arg_names);
+		return true;
+	}
+
+	AVSValue __stdcall Invoke2(const AVSValue& implicit_last, const char *name, const AVSValue args, const char *const *arg_names) { Unsupported("Invoke2"); return AVSValue(); }
+	bool __stdcall Invoke2Try(AVSValue *result, const AVSValue& implicit_last, const char *name, const AVSValue args, const char *const *arg_names) { Unsupported("Invoke2Try"); return false; }
+	AVSValue __stdcall Invoke3(const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char *const *arg_names) { Unsupported("Invoke3"); return AVSValue(); }
+	bool __stdcall Invoke3Try(AVSValue *result, const AVSValue& implicit_last, const PFunction& func, const AVSValue args, const char *const *arg_names) { Unsupported("Invoke3Try"); return false; }
+
+	// Shares the buffer, like Subframe, when the frame is held elsewhere.
+	bool __stdcall MakePropertyWritable(PVideoFrame *pvf)
+	{
+		const VideoFrame *src = pointer_of(pvf);
+		{
+			std::lock_guard<std::mutex> lock(g_ref_mutex);
+			if (src->refcount == 1)
+				return false;
+		}
+		*pvf = ShareFrame(src);
+		++g_frames_allocated;
+		return true;
+	}
+
+	// Interface version 11; extra virtuals with older headers.
+	int __stdcall propGetIntSaturated(const AVSMap *map, const char *key, int index, int *error)
+	{
+		int64_t i = propGetInt(map, key, index, error);
+		return i > INT32_MAX ? INT32_MAX : i < INT32_MIN ? INT32_MIN : (int)i;
+	}
+
+	float __stdcall propGetFloatSaturated(const AVSMap *map, const char *key, int index, int *error) { return (float)propGetFloat(map, key, index, error); }
+
+	int __stdcall propGetDataTypeHint(const AVSMap *map, const char *key, int index, int *error)
+	{
+		Find(map, key, PROPTYPE_DATA, index, error);
+		return -1;
+	}
+
+	int __stdcall propSetDataH(AVSMap *map, const char *key, const char *d, int length, int type, int append) { return propSetData(map, key, d, length, append); }
+};
+
+/* Linkage entries */
+
+namespace {
+
+class MockVideoInfo: public VideoInfo {
+public:
+	bool IsPlanar() const { return !!(pixel_type & CS_PLANAR); }
+	bool IsRGB() const { return !!(pixel_type & CS_BGR); }
+	bool IsYUV() const { return !!(pixel_type & CS_YUV); }
+	bool IsYUVA() const { return !!(pixel_type & CS_YUVA); }
+	bool IsY() const { return IsPlanar() && (pixel_type & CS_PLANAR_MASK & ~CS_Sample_Bits_Mask) == CS_GENERIC_Y; }
+	bool IsPlanarRGB() const { return IsPlanar() && IsRGB() && !(pixel_type & CS_RGBA_TYPE); }
+	bool IsPlanarRGBA() const { return IsPlanar() && IsRGB() && !!(pixel_type & CS_RGBA_TYPE); }
+	bool IsSameColorspace(const VideoInfo& vi) const { return vi.pixel_type == pixel_type; }
+	int NumComponents() const { return IsY() ? 1 : IsYUVA() || IsPlanarRGBA() ? 4 : 3; }
+
+	int BitsPerComponent() const
+	{
+		switch (pixel_type & CS_Sample_Bits_Mask) {
+		case CS_Sample_Bits_10: return 10;
+		case CS_Sample_Bits_12: return 12;
+		case CS_Sample_Bits_14: return 14;
+		case CS_Sample_Bits_16: return 16;
+		case CS_Sample_Bits_32: return 32;
+		default: return 8;
+		}
+	}
+
+	int ComponentSize() const
+	{
+		int bits = BitsPerComponent();
+		return bits == 8 ? 1 : bits == 32 ? 4 : 2;
+	}
+
+	int GetPlaneWidthSubsampling(int plane) const
+	{
+		if (plane != PLANAR_U && plane != PLANAR_V)
+			return 0;
+		if (NumComponents() == 1)
+			throw AvisynthError("Filter error: GetPlaneWidthSubsampling not available on Y pixel type.");
+		return ((pixel_type >> CS_Shift_Sub_Width) + 1) & 3;
+	}
+
+	int GetPlaneHeightSubsampling(int plane) const
+	{
+		if (plane != PLANAR_U && plane != PLANAR_V)
+			return 0;
+		if (NumComponents() == 1)
+			throw AvisynthError("Filter error: GetPlaneHeightSubsampling not available on Y pixel type.");
+		return ((pixel_type >> CS_Shift_Sub_Height) + 1) & 3;
+	}
+};
+
+class MockVideoFrame: public VideoFrame {
+public:
+	int GetPitch(int plane) const { return ScriptEnvironment::Pitch(this, plane); }
+	int GetRowSize(int plane) const { return ScriptEnvironment::RowSize(this, plane); }
+	int GetHeight(int plane) const { return ScriptEnvironment::Height(this, plane); }
+	int GetOffset(int plane) const { return ScriptEnvironment::Offset(this, plane); }
+	const BYTE *GetReadPtr(int plane) const { return ScriptEnvironment::Data(this, plane); }
+	bool IsWritable() const { return ScriptEnvironment::IsWritable(this); }
+	void Destructor() {}
+
+	// Unlike the core, returns 0 for every plane of a frame that is not
+	// writable, so that a write without MakeWritable fails at once.
+	BYTE *GetWritePtr(int plane) const { return IsWritable() ? ScriptEnvironment::Data(this, plane) : 0; }
+};
+
+class MockPClip: public PClip {
+public:
+	void Construct0() { pointer_of(this) = 0; }
+	void Construct1(const PClip& x) { Construct2(pointer_of(&x)); }
+	void Construct2(IClip *x) { add_ref(x); pointer_of(this) = x; }
+	void Assign0(IClip *x) { add_ref(x); release(pointer_of(this)); pointer_of(this) = x; }
+	void Assign1(const PClip& x) { Assign0(pointer_of(&x)); }
+	void Destruct() { release(pointer_of(this)); }
+};
+
+class MockPVideoFrame: public PVideoFrame {
+public:
+	void Construct0() { pointer_of(this) = 0; }
+	void Construct1(const PVideoFrame& x) { Construct2(pointer_of(&x)); }
+	void Construct2(VideoFrame *x) { ScriptEnvironment::AddRef(x); pointer_of(this) = x; }
+	void Assign0(VideoFrame *x) { ScriptEnvironment::AddRef(x); ScriptEnvironment::Release(pointer_of(this)); pointer_of(this) = x; }
+	void Assign1(const PVideoFrame& x) { Assign0(pointer_of(&x)); }
+	void Destruct() { ScriptEnvironment::Release(pointer_of(this)); }
+};
+
+// Strings are not copied, as in the core, where they come from SaveString.
+// Arrays are copied.
+class MockAVSValue: public AVSValue {
+	static void Init(MockValue& v, const MockValue& src)
+	{
+		v = src;
+		if (src.type == 'c') {
+			add_ref(src.clip);
+		} else if (src.type == 'a') {
+			AVSValue *array = new AVSValue[src.array_size];
+			for (int i = 0; i < src.array_size; ++i)
+				array[i] = src.array[i];
+			v.array = array;
+		}
+	}
+
+	static void Clear(MockValue& v)
+	{
+		if (v.type == 'c')
+			release(v.clip);
+		else if (v.type == 'a')
+			delete[] v.array;
+		v.type = 'v';
+	}
+
+	MockValue& self() { return value_of(this); }
+	const MockValue& self() const { return value_of(this); }
+public:
+	void Construct0() { self().type = 'v'; self().array_size = 0; self().clip = 0; }
+	void Construct1(IClip *c) { Construct0(); self().type = 'c'; self().clip = c; add_ref(c); }
+	void Construct2(const PClip& c) { Construct1(pointer_of(&c)); }
+	void Construct3(bool b) { Construct0(); self().type = 'b'; self().boolean = b; }
+	void Construct4(int i) { Construct0(); self().type = 'i'; self().integer = i; }
+	void Construct5(float f) { Construct0(); self().type = 'f'; self().floating_pt = f; }
+	void Construct6(double f) { Construct5((float)f); }
+	void Construct7(const char *s) { Construct0(); self().type = 's'; self().string = s; }
+
+	void Construct8(const AVSValue *a, int size)
+	{
+		MockValue src;
+		src.type = 'a';
+		src.array_size = (short)size;
+		src.array = a;
+		Init(self(), src);
+	}
+
+	void Construct9(const AVSValue& v) { Init(self(), value_of(&v)); }
+	void Destruct() { Clear(self()); }
+
+	// Copies before clearing, since v may be held by this value.
+	AVSValue& Assign(const AVSValue& v)
+	{
+		MockValue copy;
+		Init(copy, value_of(&v));
+		Clear(self());
+		self() = copy;
+		return *this;
+	}
+
+	const AVSValue& Index(int index) const
+	{
+		if (IsArray() && index >= 0 && index < self().array_size)
+			return self().array[index];
+		return *this;
+	}
+
+	bool Defined() const { return self().type != 'v'; }
+	bool IsClip() const { return self().type == 'c'; }
+	bool IsBool() const { return self().type == 'b'; }
+	bool IsInt() const { return self().type == 'i'; }
+	bool IsFloat() const { return self().type == 'f' || self().type == 'i'; }
+	bool IsString() const { return self().type == 's'; }
+	bool IsArray() const { return self().type == 'a'; }
+
+	PClip AsClip() const { return IsClip() ? PClip(self().clip) : PClip(); }
+	bool AsBool1() const { return self().boolean; }
+	int AsInt1() const { return self().integer; }
+	const char *AsString1() const { return IsString() ? self().string : 0; }
+	double AsFloat1() const { return IsInt() ? self().integer : self().floating_pt; }
+	bool AsBool2(bool def) const { return IsBool() ? self().boolean : def; }
+	int AsInt2(int def) const { return IsInt() ? self().integer : def; }
+	double AsDblDef(double def) const { return IsFloat() ? AsFloat1() : def; }
+	double AsFloat2(float def) const { return IsFloat() ? AsFloat1() : def; }
+	const char *AsString2(const char *def) const { return IsString() ? self().string : def; }
+	int ArraySize() const { return IsArray() ? self().array_size : 1; }
+};
+
+// Entries the plugin does not reach are left null.
+struct LinkageInit {
+	LinkageInit()
+	{
+		g_linkage = AVS_Linkage();
+		g_linkage.Size = sizeof(AVS_Linkage);
+
+		g_linkage.IsRGB = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsRGB);
+		g_linkage.IsYUV = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsYUV);
+		g_linkage.IsPlanar = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsPlanar);
+		g_linkage.GetPlaneWidthSubsampling = static_cast<int (VideoInfo::*)(int) const>(&MockVideoInfo::GetPlaneWidthSubsampling);
+		g_linkage.GetPlaneHeightSubsampling = static_cast<int (VideoInfo::*)(int) const>(&MockVideoInfo::GetPlaneHeightSubsampling);
+		g_linkage.IsSameColorspace = static_cast<bool (VideoInfo::*)(const VideoInfo&) const>(&MockVideoInfo::IsSameColorspace);
+		g_linkage.NumComponents = static_cast<int (VideoInfo::*)() const>(&MockVideoInfo::NumComponents);
+		g_linkage.ComponentSize = static_cast<int (VideoInfo::*)() const>(&MockVideoInfo::ComponentSize);
+		g_linkage.BitsPerComponent = static_cast<int (VideoInfo::*)() const>(&MockVideoInfo::BitsPerComponent);
+		g_linkage.IsY = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsY);
+		g_linkage.IsYUVA = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsYUVA);
+		g_linkage.IsPlanarRGB = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsPlanarRGB);
+		g_linkage.IsPlanarRGBA = static_cast<bool (VideoInfo::*)() const>(&MockVideoInfo::IsPlanarRGBA);
+
+		g_linkage.GetPitch = static_cast<int (VideoFrame::*)(int) const>(&MockVideoFrame::GetPitch);
+		g_linkage.GetRowSize = static_cast<int (VideoFrame::*)(int) const>(&MockVideoFrame::GetRowSize);
+		g_linkage.GetHeight = static_cast<int (VideoFrame::*)(int) const>(&MockVideoFrame::GetHeight);
+		g_linkage.GetOffset = static_cast<int (VideoFrame::*)(int) const>(&MockVideoFrame::GetOffset);
+		g_linkage.VFGetReadPtr = static_cast<const BYTE *(VideoFrame::*)(int) const>(&MockVideoFrame::GetReadPtr);
+		g_linkage.IsWritable = static_cast<bool (VideoFrame::*)() const>(&MockVideoFrame::IsWritable);
+		g_linkage.VFGetWritePtr = static_cast<BYTE *(VideoFrame::*)(int) const>(&MockVideoFrame::GetWritePtr);
+		g_linkage.VideoFrame_DESTRUCTOR = static_cast<void (VideoFrame::*)()>(&MockVideoFrame::Destructor);
+
+		g_linkage.PClip_CONSTRUCTOR0 = static_cast<void (PClip::*)()>(&MockPClip::Construct0);
+		g_linkage.PClip_CONSTRUCTOR1 = static_cast<void (PClip::*)(const PClip&)>(&MockPClip::Construct1);
+		g_linkage.PClip_CONSTRUCTOR2 = static_cast<void (PClip::*)(IClip *)>(&MockPClip::Construct2);
+		g_linkage.PClip_OPERATOR_ASSIGN0 = static_cast<void (PClip::*)(IClip *)>(&MockPClip::Assign0);
+		g_linkage.PClip_OPERATOR_ASSIGN1 = static_cast<void (PClip::*)(const PClip&)>(&MockPClip::Assign1);
+		g_linkage.PClip_DESTRUCTOR = static_cast<void (PClip::*)()>(&MockPClip::Destruct);
+
+		g_linkage.PVideoFrame_CONSTRUCTOR0 = static_cast<void (PVideoFrame::*)()>(&MockPVideoFrame::Construct0);
+		g_linkage.PVideoFrame_CONSTRUCTOR1 = static_cast<void (PVideoFrame::*)(const PVideoFrame&)>(&MockPVideoFrame::Construct1);
+		g_linkage.PVideoFrame_CONSTRUCTOR2 = static_cast<void (PVideoFrame::*)(VideoFrame *)>(&MockPVideoFrame::Construct2);
+		g_linkage.PVideoFrame_OPERATOR_ASSIGN0 = static_cast<void (PVideoFrame::*)(VideoFrame *)>(&MockPVideoFrame::Assign0);
+		g_linkage.PVideoFrame_OPERATOR_ASSIGN1 = static_cast<void (PVideoFrame::*)(const PVideoFrame&)>(&MockPVideoFrame::Assign1);
+		g_linkage.PVideoFrame_DESTRUCTOR = static_cast<void (PVideoFrame::*)()>(&MockPVideoFrame::Destruct);
+
+		g_linkage.AVSValue_CONSTRUCTOR0 = static_cast<void (AVSValue::*)()>(&MockAVSValue::Construct0);
+		g_linkage.AVSValue_CONSTRUCTOR1 = static_cast<void (AVSValue::*)(IClip *)>(&MockAVSValue::Construct1);
+		g_linkage.AVSValue_CONSTRUCTOR2 = static_cast<void (AVSValue::*)(const PClip&)>(&MockAVSValue::Construct2);
+		g_linkage.AVSValue_CONSTRUCTOR3 = static_cast<void (AVSValue::*)(bool)>(&MockAVSValue::Construct3);
+		g_linkage.AVSValue_CONSTRUCTOR4 = static_cast<void (AVSValue::*)(int)>(&MockAVSValue::Construct4);
+		g_linkage.AVSValue_CONSTRUCTOR5 = static_cast<void (AVSValue::*)(float)>(&MockAVSValue::Construct5);
+		g_linkage.AVSValue_CONSTRUCTOR6 = static_cast<void (AVSValue::*)(double)>(&MockAVSValue::Construct6);
+		g_linkage.AVSValue_CONSTRUCTOR7 = static_cast<void (AVSValue::*)(const char *)>(&MockAVSValue::Construct7);
+		g_linkage.AVSValue_CONSTRUCTOR8 = static_cast<void (AVSValue::*)(const AVSValue *, int)>(&MockAVSValue::Construct8);
+		g_linkage.AVSValue_CONSTRUCTOR9 = static_cast<void (AVSValue::*)(const AVSValue&)>(&MockAVSValue::Construct9);
+		g_linkage.AVSValue_DESTRUCTOR = static_cast<void (AVSValue::*)()>(&MockAVSValue::Destruct);
+		g_linkage.AVSValue_OPERATOR_ASSIGN = static_cast<AVSValue& (AVSValue::*)(const AVSValue&)>(&MockAVSValue::Assign);
+		g_linkage.AVSValue_OPERATOR_INDEX = static_cast<const AVSValue& (AVSValue::*)(int) const>(&MockAVSValue::Index);
+		g_linkage.Defined = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::Defined);
+		g_linkage.IsClip = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsClip);
+		g_linkage.IsBool = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsBool);
+		g_linkage.IsInt = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsInt);
+		g_linkage.IsFloat = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsFloat);
+		g_linkage.IsString = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsString);
+		g_linkage.IsArray = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::IsArray);
+		g_linkage.AsClip = static_cast<PClip (AVSValue::*)() const>(&MockAVSValue::AsClip);
+		g_linkage.AsBool1 = static_cast<bool (AVSValue::*)() const>(&MockAVSValue::AsBool1);
+		g_linkage.AsInt1 = static_cast<int (AVSValue::*)() const>(&MockAVSValue::AsInt1);
+		g_linkage.AsString1 = static_cast<const char *(AVSValue::*)() const>(&MockAVSValue::AsString1);
+		g_linkage.AsFloat1 = static_cast<double (AVSValue::*)() const>(&MockAVSValue::AsFloat1);
+		g_linkage.AsBool2 = static_cast<bool (AVSValue::*)(bool) const>(&MockAVSValue::AsBool2);
+		g_linkage.AsInt2 = static_cast<int (AVSValue::*)(int) const>(&MockAVSValue::AsInt2);
+		g_linkage.AsDblDef = static_cast<double (AVSValue::*)(double) const>(&MockAVSValue::AsDblDef);
+		g_linkage.AsFloat2 = static_cast<double (AVSValue::*)(float) const>(&MockAVSValue::AsFloat2);
+		g_linkage.AsString2 = static_cast<const char *(AVSValue::*)(const char *) const>(&MockAVSValue::AsString2);
+		g_linkage.ArraySize = static_cast<int (AVSValue::*)() const>(&MockAVSValue::ArraySize);
+	}
+} g_linkage_init;
+
+ScriptEnvironment g_env;
+
+// The AviSynth+ type for each mock_source format, indexed by (bits - 8) / 2.
+struct MockPixelTypes {
+	int family;
+	int ssw;
+	int ssh;
+	int types[5];
+};
+
+const MockPixelTypes pixel_types[] = {
+	{ cmGray, 0, 0, { CS_Y8, CS_Y10, CS_Y12, CS_Y14, CS_Y16 } },
+	{ cmYUV, 1, 1, { CS_YV12, CS_YUV420P10, CS_YUV420P12, CS_YUV420P14, CS_YUV420P16 } },
+	{ cmYUV, 1, 0, { CS_YV16, CS_YUV422P10, CS_YUV422P12, CS_YUV422P14, CS_YUV422P16 } },
+	{ cmYUV, 0, 0, { CS_YV24, CS_YUV444P10, CS_YUV444P12, CS_YUV444P14, CS_YUV444P16 } },
+	{ cmRGB, 0, 0, { CS_RGBP8, CS_RGBP10, CS_RGBP12, CS_RGBP14, CS_RGBP16 } },
+};
+
+class MockSource: public IClip {
+	VideoInfo m_vi;
+	std::vector<PVideoFrame> m_pool;
+public:
+	MockSource(const VideoInfo& vi, const std::vector<PVideoFrame>& pool) : m_vi(vi), m_pool(pool) {}
+
+	PVideoFrame __stdcall GetFrame(int n, IScriptEnvironment *env)
+	{
+		n = n < 0 ? 0 : n >= m_vi.num_frames ? m_vi.num_frames - 1 : n;
+		return m_pool[n % m_pool.size()];
+	}
+
+	bool __stdcall GetParity(int n) { return false; }
+	void __stdcall GetAudio(void *buf, int64_t start, int64_t count, IScriptEnvironment *env) {}
+	int __stdcall SetCacheHints(int cachehints, int frame_range) { return 0; }
+	const VideoInfo& __stdcall GetVideoInfo() { return m_vi; }
+};
+
+} // namespace
+
+IScriptEnvironment *mock_avs_env()
+{
+	return &g_env;
+}
+
+void mock_avs_load_plugin(MockAvsInit init)
+{
+	init(&g_env, &g_linkage);
+}
+
+PClip mock_avs_source(const VSFormat *format, int width, int height, int num_frames, int pool_size, bool damage)
+{
+	VideoInfo vi;
+	memset(&vi, 0, sizeof(vi));
+	vi.width = width;
+	vi.height = height;
+	vi.fps_numerator = 24000;
+	vi.fps_denominator = 1001;
+	vi.num_frames = num_frames;
+
+	for (size_t i = 0; i < sizeof(pixel_types) / sizeof(pixel_types[0]); ++i) {
+		const MockPixelTypes& t = pixel_types[i];
+		if (t.family == format->colorFamily && t.ssw == format->subSamplingW && t.ssh == format->subSamplingH && !(format->bitsPerSample & 1))
+			vi.pixel_type = t.types[(format->bitsPerSample - 8) / 2];
+	}
+	if (!vi.pixel_type)
+		g_env.ThrowError("mockavs: %s has no AviSynth+ pixel type", format->name);
+
+	// Copies the frames of the VapourSynth mock, so both hosts see the same input.
+	static const int yuv_planes[3] = { PLANAR_Y, PLANAR_U, PLANAR_V };
+	static const int rgb_planes[3] = { PLANAR_R, PLANAR_G, PLANAR_B };
+	const VSAPI *vsapi = mock_vsapi();
+	VSNodeRef *node = mock_source(format, width, height, num_frames, pool_size, damage);
+	std::vector<PVideoFrame> pool;
+	std::string error;
+
+	for (int i = 0; i < pool_size; ++i) {
+		const VSFrameRef *src = mock_get_frame(node, i, error);
+		PVideoFrame dst = g_env.NewVideoFrame(vi, FRAME_ALIGN);
+		for (int p = 0; p < format->numPlanes; ++p) {
+			int plane = format->colorFamily == cmRGB ? rgb_planes[p] : yuv_planes[p];
+			g_env.BitBlt(dst->GetWritePtr(plane), dst->GetPitch(plane), vsapi->getReadPtr(src, p), vsapi->getStride(src, p),
+			             vsapi->getFrameWidth(src, p) * format->bytesPerSample, vsapi->getFrameHeight(src, p));
+		}
+		vsapi->freeFrame(src);
+		pool.push_back(dst);
+	}
+	vsapi->freeNode(node);
+
+	return new MockSource(vi, pool);
+}
+
+MockCounters mock_avs_counters()
+{
+	MockCounters c;
+	c.frames_allocated = g_frames_allocated;
+	c.planes_allocated = g_planes_allocated;
+	c.planes_copied = g_planes_copied;
+	c.bytes_copied = g_bytes_copied;
+	return c;
+}
+
+void mock_avs_reset_counters()
+{
+	g_frames_allocated = 0;
+	g_planes_allocated = 0;
+	g_planes_copied = 0;
+	g_bytes_copied = 0;
+}
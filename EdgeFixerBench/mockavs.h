@@ -0,0 +1,31 @@
+#ifndef MOCKAVS_H
+#define MOCKAVS_H
+
+#include <avisynth.h>
+#include "mockvs.h"
+
+// A small in-process stand-in for the AviSynth+ core, sufficient to load
+// avsplugin.cpp and drive its filters without AviSynth+ installed. It
+// supplies the AVS_Linkage through which the plugin reaches VideoInfo,
+// VideoFrame, PClip, PVideoFrame and AVSValue, and an IScriptEnvironment
+// whose frames are reference counted and copied by MakeWritable like in the
+// real core, so plane copies made by the filter show up in the counters.
+//
+// Call mock_avs_load_plugin first: the mock's own use of those classes goes
+// through the AVS_linkage pointer the plugin stores.
+
+typedef const char *(__stdcall *MockAvsInit)(IScriptEnvironment *env, const AVS_Linkage *const vectors);
+
+IScriptEnvironment *mock_avs_env();
+
+// Calls AvisynthPluginInit3; the added functions are reached through Invoke.
+void mock_avs_load_plugin(MockAvsInit init);
+
+// Creates a source clip holding the frames mock_source would produce.
+// Throws AvisynthError if format has no AviSynth+ counterpart.
+PClip mock_avs_source(const VSFormat *format, int width, int height, int num_frames, int pool_size, bool damage);
+
+MockCounters mock_avs_counters();
+void mock_avs_reset_counters();
+
+#endif // MOCKAVS_H
@@ -0,0 +1,627 @@
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mockvs.h"
+
+struct MockPlane {
+	std::vector<uint8_t> data;
+	int width;
+	int height;
+	int stride;
+
+	~MockPlane();
+};
+
+struct MockEntry {
+	char type;
+	std::vector<int64_t> ints;
+	std::vector<double> floats;
+	std::vector<std::string> data;
+	std::vector<std::shared_ptr<struct MockNode> > nodes;
+	std::vector<std::shared_ptr<struct MockFrame> > frames;
+};
+
+struct VSMap {
+	std::map<std::string, MockEntry> entries;
+	std::string error;
+};
+
+struct MockFrame {
+	const VSFormat *format;
+	std::shared_ptr<MockPlane> planes[3];
+	VSMap props;
+};
+
+struct MockNode {
+	VSVideoInfo vi;
+	VSFilterGetFrame get_frame;
+	VSFilterFree free;
+	void *instance_data;
+	std::vector<std::shared_ptr<MockFrame> > pool;
+
+	MockNode() : get_frame(0), free(0), instance_data(0) {}
+	~MockNode();
+};
+
+struct VSNodeRef {
+	std::shared_ptr<MockNode> node;
+};
+
+struct VSFrameRef {
+	std::shared_ptr<MockFrame> frame;
+};
+
+struct VSFrameContext {
+	std::vector<std::pair<std::shared_ptr<MockNode>, int> > requested;
+	std::vector<std::pair<std::pair<MockNode *, int>, std::shared_ptr<MockFrame> > > ready;
+	std::string error;
+};
+
+struct VSCore {
+	int dummy;
+};
+
+namespace {
+
+std::atomic<uint64_t> g_frames_allocated(0);
+std::atomic<uint64_t> g_planes_allocated(0);
+std::atomic<uint64_t> g_planes_copied(0);
+std::atomic<uint64_t> g_bytes_copied(0);
+
+VSCore g_core;
+VSAPI g_api;
+
+const size_t max_pooled_buffers = 64;
+std::mutex g_pool_mutex;
+std::vector<std::vector<uint8_t> > g_pool;
+
+std::mutex g_format_mutex;
+std::vector<std::unique_ptr<VSFormat> > g_formats;
+
+struct MockFunction {
+	VSPublicFunction func;
+	void *data;
+};
+std::map<std::string, MockFunction> g_functions;
+
+const MockEntry *find_entry(const VSMap *map, const char *key, char type, int index, int *error)
+{
+	std::map<std::string, MockEntry>::const_iterator it = map->entries.find(key);
+	int err = 0;
+
+	if (it == map->entries.end())
+		err = peUnset;
+	else if (it->second.type != type)
+		err = peType;
+	else {
+		size_t size = type == ptInt ? it->second.ints.size() : type == ptFloat ? it->second.floats.size() :
+		              type == ptData ? it->second.data.size() : type == ptNode ? it->second.nodes.size() : it->second.frames.size();
+		if (index < 0 || (size_t)index >= size)
+			err = peIndex;
+	}
+
+	if (error)
+		*error = err;
+	else if (err)
+		fprintf(stderr, "mockvs: missing property %s\n", key), abort();
+	return err ? 0 : &it->second;
+}
+
+MockEntry *set_entry(VSMap *map, const char *key, char type, int append)
+{
+	std::map<std::string, MockEntry>::iterator it = map->entries.find(key);
+	if (it != map->entries.end()) {
+		if (append == paReplace || it->second.type != type) {
+			it->second = MockEntry();
+			it->second.type = type;
+		}
+		return &it->second;
+	}
+	MockEntry& entry = map->entries[key];
+	entry.type = type;
+	return &entry;
+}
+
+std::shared_ptr<MockPlane> new_plane(int width, int height, int bytes)
+{
+	std::shared_ptr<MockPlane> plane = std::make_shared<MockPlane>();
+	plane->width = width;
+	plane->height = height;
+	plane->stride = (width * bytes + 31) & ~31;
+	plane->data = mock_take_buffer((size_t)plane->stride * height);
+	++g_planes_allocated;
+	return plane;
+}
+
+std::shared_ptr<MockFrame> new_frame(const VSFormat *format, int width, int height)
+{
+	std::shared_ptr<MockFrame> frame = std::make_shared<MockFrame>();
+	frame->format = format;
+	for (int p = 0; p < format->numPlanes; ++p) {
+		int w = p ? width >> format->subSamplingW : width;
+		int h = p ? height >> format->subSamplingH : height;
+		frame->planes[p] = new_plane(w, h, format->bytesPerSample);
+	}
+	++g_frames_allocated;
+	return frame;
+}
+
+VSFrameRef *make_ref(const std::shared_ptr<MockFrame>& frame)
+{
+	VSFrameRef *ref = new VSFrameRef;
+	ref->frame = frame;
+	return ref;
+}
+
+VSNodeRef *make_ref(const std::shared_ptr<MockNode>& node)
+{
+	VSNodeRef *ref = new VSNodeRef;
+	ref->node = node;
+	return ref;
+}
+
+// Evaluates a node the way the core's frame scheduler would, minus caching.
+std::shared_ptr<MockFrame> evaluate(const std::shared_ptr<MockNode>& node, int n, std::string& error)
+{
+	if (n < 0)
+		n = 0;
+	if (n >= node->vi.numFrames)
+		n = node->vi.numFrames - 1;
+	if (!node->get_frame)
+		return node->pool[n % node->pool.size()];
+
+	VSFrameContext ctx;
+	void *frame_data = 0;
+
+	node->get_frame(n, arInitial, &node->instance_data, &frame_data, &ctx, &g_core, &g_api);
+	if (!ctx.error.empty()) {
+		error = ctx.error;
+		return std::shared_ptr<MockFrame>();
+	}
+
+	for (size_t i = 0; i < ctx.requested.size(); ++i) {
+		std::shared_ptr<MockFrame> f = evaluate(ctx.requested[i].first, ctx.requested[i].second, error);
+		if (!f)
+			return f;
+		ctx.ready.push_back(std::make_pair(std::make_pair(ctx.requested[i].first.get(), ctx.requested[i].second), f));
+	}
+
+	const VSFrameRef *ret = node->get_frame(n, arAllFramesReady, &node->instance_data, &frame_data, &ctx, &g_core, &g_api);
+	if (!ret) {
+		error = ctx.error.empty() ? "filter returned no frame" : ctx.error;
+		return std::shared_ptr<MockFrame>();
+	}
+
+	std::shared_ptr<MockFrame> result = ret->frame;
+	delete ret;
+	return result;
+}
+
+/* API implementation */
+
+const VSFrameRef *VS_CC cloneFrameRef(const VSFrameRef *f) VS_NOEXCEPT { return make_ref(f->frame); }
+VSNodeRef *VS_CC cloneNodeRef(VSNodeRef *node) VS_NOEXCEPT { return make_ref(node->node); }
+void VS_CC freeFrame(const VSFrameRef *f) VS_NOEXCEPT { delete f; }
+void VS_CC freeNode(VSNodeRef *node) VS_NOEXCEPT { delete node; }
+
+VSFrameRef *VS_CC newVideoFrame(const VSFormat *format, int width, int height, const VSFrameRef *propSrc, VSCore *core) VS_NOEXCEPT
+{
+	std::shared_ptr<MockFrame> frame = new_frame(format, width, height);
+	if (propSrc)
+		frame->props.entries = propSrc->frame->props.entries;
+	return make_ref(frame);
+}
+
+VSFrameRef *VS_CC newVideoFrame2(const VSFormat *format, int width, int height, const VSFrameRef **planeSrc, const int *planes, const VSFrameRef *propSrc, VSCore *core) VS_NOEXCEPT
+{
+	std::shared_ptr<MockFrame> frame = std::make_shared<MockFrame>();
+	frame->format = format;
+	for (int p = 0; p < format->numPlanes; ++p) {
+		if (planeSrc && planeSrc[p]) {
+			frame->planes[p] = planeSrc[p]->frame->planes[planes[p]];
+		} else {
+			int w = p ? width >> format->subSamplingW : width;
+			int h = p ? height >> format->subSamplingH : height;
+			frame->planes[p] = new_plane(w, h, format->bytesPerSample);
+		}
+	}
+	if (propSrc)
+		frame->props.entries = propSrc->frame->props.entries;
+	++g_frames_allocated;
+	return make_ref(frame);
+}
+
+VSFrameRef *VS_CC copyFrame(const VSFrameRef *f, VSCore *core) VS_NOEXCEPT
+{
+	std::shared_ptr<MockFrame> frame = std::make_shared<MockFrame>(*f->frame);
+	++g_frames_allocated;
+	return make_ref(frame);
+}
+
+void VS_CC copyFrameProps(const VSFrameRef *src, VSFrameRef *dst, VSCore *core) VS_NOEXCEPT
+{
+	dst->frame->props.entries = src->frame->props.entries;
+}
+
+void VS_CC createFilter(const VSMap *in, VSMap *out, const char *name, VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, int filterMode, int flags, void *instanceData, VSCore *core) VS_NOEXCEPT
+{
+	std::shared_ptr<MockNode> node = std::make_shared<MockNode>();
+	node->get_frame = getFrame;
+	node->free = free;
+	node->instance_data = instanceData;
+	init(const_cast<VSMap *>(in), out, &node->instance_data, reinterpret_cast<VSNode *>(node.get()), core, &g_api);
+	set_entry(out, "clip", ptNode, paReplace)->nodes.push_back(node);
+}
+
+void VS_CC setError(VSMap *map, const char *errorMessage) VS_NOEXCEPT { map->entries.clear(); map->error = errorMessage ? errorMessage : ""; }
+const char *VS_CC getError(const VSMap *map) VS_NOEXCEPT { return map->error.empty() ? 0 : map->error.c_str(); }
+void VS_CC setFilterError(const char *errorMessage, VSFrameContext *frameCtx) VS_NOEXCEPT { frameCtx->error = errorMessage; }
+
+const VSFormat *VS_CC registerFormat(int colorFamily, int sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, VSCore *core) VS_NOEXCEPT
+{
+	std::lock_guard<std::mutex> lock(g_format_mutex);
+	for (size_t i = 0; i < g_formats.size(); ++i) {
+		const VSFormat *f = g_formats[i].get();
+		if (f->colorFamily == colorFamily && f->sampleType == sampleType && f->bitsPerSample == bitsPerSample && f->subSamplingW == subSamplingW && f->subSamplingH == subSamplingH)
+			return f;
+	}
+
+	std::unique_ptr<VSFormat> f(new VSFormat());
+	snprintf(f->name, sizeof(f->name), "Mock%d_%d_%d_%d_%d", colorFamily, sampleType, bitsPerSample, subSamplingW, subSamplingH);
+	f->id = (int)g_formats.size() + 1;
+	f->colorFamily = colorFamily;
+	f->sampleType = sampleType;
+	f->bitsPerSample = bitsPerSample;
+	f->bytesPerSample = bitsPerSample > 16 ? 4 : bitsPerSample > 8 ? 2 : 1;
+	f->subSamplingW = subSamplingW;
+	f->subSamplingH = subSamplingH;
+	f->numPlanes = colorFamily == cmGray ? 1 : 3;
+	g_formats.push_back(std::move(f));
+	return g_formats.back().get();
+}
+
+const VSFrameRef *VS_CC getFrameFilter(int n, VSNodeRef *node, VSFrameContext *frameCtx) VS_NOEXCEPT
+{
+	n = n < 0 ? 0 : n >= node->node->vi.numFrames ? node->node->vi.numFrames - 1 : n;
+	for (size_t i = 0; i < frameCtx->ready.size(); ++i) {
+		if (frameCtx->ready[i].first.first == node->node.get() && frameCtx->ready[i].first.second == n)
+			return make_ref(frameCtx->ready[i].second);
+	}
+	return 0;
+}
+
+void VS_CC requestFrameFilter(int n, VSNodeRef *node, VSFrameContext *frameCtx) VS_NOEXCEPT
+{
+	n = n < 0 ? 0 : n >= node->node->vi.numFrames ? node->node->vi.numFrames - 1 : n;
+	frameCtx->requested.push_back(std::make_pair(node->node, n));
+}
+
+int VS_CC getStride(const VSFrameRef *f, int plane) VS_NOEXCEPT { return f->frame->planes[plane]->stride; }
+const uint8_t *VS_CC getReadPtr(const VSFrameRef *f, int plane) VS_NOEXCEPT { return f->frame->planes[plane]->data.data(); }
+
+uint8_t *VS_CC getWritePtr(VSFrameRef *f, int plane) VS_NOEXCEPT
+{
+	std::shared_ptr<MockPlane>& p = f->frame->planes[plane];
+	if (p.use_count() > 1) {
+		std::shared_ptr<MockPlane> copy = std::make_shared<MockPlane>();
+		copy->width = p->width;
+		copy->height = p->height;
+		copy->stride = p->stride;
+		copy->data = mock_take_buffer(p->data.size());
+		memcpy(copy->data.data(), p->data.data(), p->data.size());
+		p = copy;
+		++g_planes_allocated;
+		++g_planes_copied;
+		g_bytes_copied += p->data.size();
+	}
+	return p->data.data();
+}
+
+VSMap *VS_CC createMap(void) VS_NOEXCEPT { return new VSMap; }
+void VS_CC freeMap(VSMap *map) VS_NOEXCEPT { delete map; }
+void VS_CC clearMap(VSMap *map) VS_NOEXCEPT { map->entries.clear(); map->error.clear(); }
+
+const VSVideoInfo *VS_CC getVideoInfo(VSNodeRef *node) VS_NOEXCEPT { return &node->node->vi; }
+void VS_CC setVideoInfo(const VSVideoInfo *vi, int numOutputs, VSNode *node) VS_NOEXCEPT { reinterpret_cast<MockNode *>(node)->vi = *vi; }
+const VSFormat *VS_CC getFrameFormat(const VSFrameRef *f) VS_NOEXCEPT { return f->frame->format; }
+int VS_CC getFrameWidth(const VSFrameRef *f, int plane) VS_NOEXCEPT { return f->frame->planes[plane]->width; }
+int VS_CC getFrameHeight(const VSFrameRef *f, int plane) VS_NOEXCEPT { return f->frame->planes[plane]->height; }
+const VSMap *VS_CC getFramePropsRO(const VSFrameRef *f) VS_NOEXCEPT { return &f->frame->props; }
+VSMap *VS_CC getFramePropsRW(VSFrameRef *f) VS_NOEXCEPT { return &f->frame->props; }
+
+int VS_CC propNumKeys(const VSMap *map) VS_NOEXCEPT { return (int)map->entries.size(); }
+
+const char *VS_CC propGetKey(const VSMap *map, int index) VS_NOEXCEPT
+{
+	std::map<std::string, MockEntry>::const_iterator it = map->entries.begin();
+	std::advance(it, index);
+	return it->first.c_str();
+}
+
+int VS_CC propNumElements(const VSMap *map, const char *key) VS_NOEXCEPT
+{
+	std::map<std::string, MockEntry>::const_iterator it = map->entries.find(key);
+	if (it == map->entries.end())
+		return -1;
+	const MockEntry& e = it->second;
+	return (int)(e.type == ptInt ? e.ints.size() : e.type == ptFloat ? e.floats.size() : e.type == ptData ? e.data.size() : e.type == ptNode ? e.nodes.size() : e.frames.size());
+}
+
+char VS_CC propGetType(const VSMap *map, const char *key) VS_NOEXCEPT
+{
+	std::map<std::string, MockEntry>::const_iterator it = map->entries.find(key);
+	return it == map->entries.end() ? ptUnset : it->second.type;
+}
+
+int64_t VS_CC propGetInt(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptInt, index, error);
+	return e ? e->ints[index] : 0;
+}
+
+double VS_CC propGetFloat(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptFloat, index, error);
+	return e ? e->floats[index] : 0;
+}
+
+const char *VS_CC propGetData(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptData, index, error);
+	return e ? e->data[index].c_str() : 0;
+}
+
+int VS_CC propGetDataSize(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptData, index, error);
+	return e ? (int)e->data[index].size() : 0;
+}
+
+VSNodeRef *VS_CC propGetNode(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptNode, index, error);
+	return e ? make_ref(e->nodes[index]) : 0;
+}
+
+const VSFrameRef *VS_CC propGetFrame(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptFrame, index, error);
+	return e ? make_ref(e->frames[index]) : 0;
+}
+
+int VS_CC propDeleteKey(VSMap *map, const char *key) VS_NOEXCEPT { return (int)map->entries.erase(key); }
+
+int VS_CC propSetInt(VSMap *map, const char *key, int64_t i, int append) VS_NOEXCEPT { set_entry(map, key, ptInt, append)->ints.push_back(i); return 0; }
+int VS_CC propSetFloat(VSMap *map, const char *key, double d, int append) VS_NOEXCEPT { set_entry(map, key, ptFloat, append)->floats.push_back(d); return 0; }
+
+int VS_CC propSetData(VSMap *map, const char *key, const char *data, int size, int append) VS_NOEXCEPT
+{
+	set_entry(map, key, ptData, append)->data.push_back(size < 0 ? std::string(data) : std::string(data, size));
+	return 0;
+}
+
+int VS_CC propSetNode(VSMap *map, const char *key, VSNodeRef *node, int append) VS_NOEXCEPT { set_entry(map, key, ptNode, append)->nodes.push_back(node->node); return 0; }
+int VS_CC propSetFrame(VSMap *map, const char *key, const VSFrameRef *f, int append) VS_NOEXCEPT { set_entry(map, key, ptFrame, append)->frames.push_back(f->frame); return 0; }
+
+const int64_t *VS_CC propGetIntArray(const VSMap *map, const char *key, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptInt, 0, error);
+	return e ? e->ints.data() : 0;
+}
+
+const double *VS_CC propGetFloatArray(const VSMap *map, const char *key, int *error) VS_NOEXCEPT
+{
+	const MockEntry *e = find_entry(map, key, ptFloat, 0, error);
+	return e ? e->floats.data() : 0;
+}
+
+int VS_CC propSetIntArray(VSMap *map, const char *key, const int64_t *i, int size) VS_NOEXCEPT { set_entry(map, key, ptInt, paReplace)->ints.assign(i, i + size); return 0; }
+int VS_CC propSetFloatArray(VSMap *map, const char *key, const double *d, int size) VS_NOEXCEPT { set_entry(map, key, ptFloat, paReplace)->floats.assign(d, d + size); return 0; }
+
+void VS_CC logMessage(int msgType, const char *msg) VS_NOEXCEPT { fprintf(stderr, "%s\n", msg); }
+
+void VS_CC configPlugin(const char *identifier, const char *defaultNamespace, const char *name, int apiVersion, int readonly, VSPlugin *plugin)
+{
+}
+
+void VS_CC registerFunction(const char *name, const char *args, VSPublicFunction argsFunc, void *functionData, VSPlugin *plugin)
+{
+	MockFunction f = { argsFunc, functionData };
+	g_functions[name] = f;
+}
+
+struct ApiInit {
+	ApiInit()
+	{
+		memset(&g_api, 0, sizeof(g_api));
+		g_api.cloneFrameRef = cloneFrameRef;
+		g_api.cloneNodeRef = cloneNodeRef;
+		g_api.freeFrame = freeFrame;
+		g_api.freeNode = freeNode;
+		g_api.newVideoFrame = newVideoFrame;
+		g_api.copyFrame = copyFrame;
+		g_api.copyFrameProps = copyFrameProps;
+		g_api.createFilter = createFilter;
+		g_api.setError = setError;
+		g_api.getError = getError;
+		g_api.setFilterError = setFilterError;
+		g_api.registerFormat = registerFormat;
+		g_api.getFrameFilter = getFrameFilter;
+		g_api.requestFrameFilter = requestFrameFilter;
+		g_api.getStride = getStride;
+		g_api.getReadPtr = getReadPtr;
+		g_api.getWritePtr = getWritePtr;
+		g_api.createMap = createMap;
+		g_api.freeMap = freeMap;
+		g_api.clearMap = clearMap;
+		g_api.getVideoInfo = getVideoInfo;
+		g_api.setVideoInfo = setVideoInfo;
+		g_api.getFrameFormat = getFrameFormat;
+		g_api.getFrameWidth = getFrameWidth;
+		g_api.getFrameHeight = getFrameHeight;
+		g_api.getFramePropsRO = getFramePropsRO;
+		g_api.getFramePropsRW = getFramePropsRW;
+		g_api.propNumKeys = propNumKeys;
+		g_api.propGetKey = propGetKey;
+		g_api.propNumElements = propNumElements;
+		g_api.propGetType = propGetType;
+		g_api.propGetInt = propGetInt;
+		g_api.propGetFloat = propGetFloat;
+		g_api.propGetData = propGetData;
+		g_api.propGetDataSize = propGetDataSize;
+		g_api.propGetNode = propGetNode;
+		g_api.propGetFrame = propGetFrame;
+		g_api.propDeleteKey = propDeleteKey;
+		g_api.propSetInt = propSetInt;
+		g_api.propSetFloat = propSetFloat;
+		g_api.propSetData = propSetData;
+		g_api.propSetNode = propSetNode;
+		g_api.propSetFrame = propSetFrame;
+		g_api.newVideoFrame2 = newVideoFrame2;
+		g_api.propGetIntArray = propGetIntArray;
+		g_api.propGetFloatArray = propGetFloatArray;
+		g_api.propSetIntArray = propSetIntArray;
+		g_api.propSetFloatArray = propSetFloatArray;
+		g_api.logMessage = logMessage;
+	}
+} g_api_init;
+
+} // namespace
+
+// Plane buffers are recycled, as in the core's frame pool, so that the cost
+// of a new frame does not depend on how the C runtime returns large blocks
+// to the system.
+std::vector<uint8_t> mock_take_buffer(size_t size)
+{
+	std::lock_guard<std::mutex> lock(g_pool_mutex);
+	for (size_t i = 0; i < g_pool.size(); ++i) {
+		if (g_pool[i].size() == size) {
+			std::vector<uint8_t> buffer;
+			buffer.swap(g_pool[i]);
+			g_pool[i].swap(g_pool.back());
+			g_pool.pop_back();
+			return buffer;
+		}
+	}
+	return std::vector<uint8_t>(size);
+}
+
+void mock_give_buffer(std::vector<uint8_t>& buffer)
+{
+	std::lock_guard<std::mutex> lock(g_pool_mutex);
+	if (g_pool.size() < max_pooled_buffers) {
+		g_pool.push_back(std::vector<uint8_t>());
+		g_pool.back().swap(buffer);
+	}
+}
+
+MockPlane::~MockPlane()
+{
+	mock_give_buffer(data);
+}
+
+MockNode::~MockNode()
+{
+	if (free)
+		free(instance_data, &g_core, &g_api);
+}
+
+const VSAPI *mock_vsapi()
+{
+	return &g_api;
+}
+
+VSCore *mock_core()
+{
+	return &g_core;
+}
+
+void mock_load_plugin(VSInitPlugin init)
+{
+	init(configPlugin, registerFunction, 0);
+}
+
+VSMap *mock_invoke(const char *name, const VSMap *in)
+{
+	VSMap *out = new VSMap;
+	std::map<std::string, MockFunction>::const_iterator it = g_functions.find(name);
+	if (it == g_functions.end())
+		setError(out, "no such function");
+	else
+		it->second.func(in, out, it->second.data, &g_core, &g_api);
+	return out;
+}
+
+template <class T>
+static void fill_plane(MockPlane& plane, int seed, int max_value, bool damage)
+{
+	for (int y = 0; y < plane.height; ++y) {
+		T *row = reinterpret_cast<T *>(plane.data.data() + (size_t)plane.stride * y);
+		for (int x = 0; x < plane.width; ++x) {
+			// Smooth gradient plus a little texture, so fits are well conditioned.
+			unsigned h = (unsigned)(x * 73856093u ^ y * 19349663u ^ seed * 83492791u);
+			double v = 0.25 + 0.5 * (x + y) / (plane.width + plane.height) + ((h >> 8) % 64) / 1024.0;
+			int edge = x < y ? x : y;
+			edge = edge < plane.width - 1 - x ? edge : plane.width - 1 - x;
+			edge = edge < plane.height - 1 - y ? edge : plane.height - 1 - y;
+			if (damage && edge < 2)
+				v *= edge ? 1.15 : 0.8;
+			row[x] = (T)(v * max_value);
+		}
+	}
+}
+
+VSNodeRef *mock_source(const VSFormat *format, int width, int height, int num_frames, int pool_size, bool damage)
+{
+	std::shared_ptr<MockNode> node = std::make_shared<MockNode>();
+	node->vi.format = format;
+	node->vi.fpsNum = 24000;
+	node->vi.fpsDen = 1001;
+	node->vi.width = width;
+	node->vi.height = height;
+	node->vi.numFrames = num_frames;
+	node->vi.flags = 0;
+
+	for (int i = 0; i < pool_size; ++i) {
+		std::shared_ptr<MockFrame> frame = new_frame(format, width, height);
+		for (int p = 0; p < format->numPlanes; ++p) {
+			if (format->bytesPerSample == 1)
+				fill_plane<uint8_t>(*frame->planes[p], i * 3 + p, 255, damage);
+			else
+				fill_plane<uint16_t>(*frame->planes[p], i * 3 + p, (1 << format->bitsPerSample) - 1, damage);
+		}
+		node->pool.push_back(frame);
+	}
+	return make_ref(node);
+}
+
+const VSFrameRef *mock_get_frame(VSNodeRef *node, int n, std::string& error)
+{
+	std::shared_ptr<MockFrame> frame = evaluate(node->node, n, error);
+	return frame ? make_ref(frame) : 0;
+}
+
+MockCounters mock_counters()
+{
+	MockCounters c;
+	c.frames_allocated = g_frames_allocated;
+	c.planes_allocated = g_planes_allocated;
+	c.planes_copied = g_planes_copied;
+	c.bytes_copied = g_bytes_copied;
+	return c;
+}
+
+void mock_reset_counters()
+{
+	g_frames_allocated = 0;
+	g_planes_allocated = 0;
+	g_planes_copied = 0;
+	g_bytes_copied = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef MOCKVS_H
+#define MOCKVS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <VapourSynth.h>
+
+// A small in-process stand-in for the VapourSynth core, sufficient to load
+// vsplugin.c and drive its filters without VapourSynth installed. Frames are
+// reference counted and copy-on-write like in the real core, so plane copies
+// made by the filter show up in the counters below.
+
+struct MockCounters {
+	uint64_t frames_allocated;
+	uint64_t planes_allocated;
+	uint64_t planes_copied;
+	uint64_t bytes_copied;
+};
+
+const VSAPI *mock_vsapi();
+VSCore *mock_core();
+
+// Calls VapourSynthPluginInit and records the registered functions.
+void mock_load_plugin(VSInitPlugin init);
+
+// Invokes a registered function. Returns the output map; check getError.
+VSMap *mock_invoke(const char *name, const VSMap *in);
+
+// Creates a source node that cycles through pool_size synthetic frames.
+// damage scales the outermost lines to produce border artifacts to fix.
+VSNodeRef *mock_source(const VSFormat *format, int width, int height, int num_frames, int pool_size, bool damage);
+
+// Produces frame n of node as a filter graph would, running the filter's
+// arInitial and arAllFramesReady steps. Returns 0 and fills error on failure.
+const VSFrameRef *mock_get_frame(VSNodeRef *node, int n, std::string& error);
+
+MockCounters mock_counters();
+void mock_reset_counters();
+
+// Plane buffers of both mock cores come from one recycling pool.
+std::vector<uint8_t> mock_take_buffer(size_t size);
+void mock_give_buffer(std::vector<uint8_t>& buffer);
+
+#endif // MOCKVS_H
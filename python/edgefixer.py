@@ -0,0 +1,499 @@
+"""Python binding for the EdgeFixer core.
+
+Fixing operates in place on NumPy arrays or any other writable buffer-protocol object
+holding uint8, uint16 or float32 samples. A 2-D array is a single plane; a
+3-D array is a batch of planes along the first axis. Batches are spread across
+a thread pool; ctypes releases the GIL for the duration of each call.
+
+The shared library is located through the EDGEFIXER_LIBRARY environment
+variable, next to this module, or on the system library path.
+
+scan() measures border lines of a clip and recommends edge counts and a
+radius per scene. It only reads the lines it measures.
+"""
+
+import ctypes
+import ctypes.util
+import os
+from bisect import bisect_left
+from concurrent.futures import ThreadPoolExecutor
+
+__all__ = ['continuity', 'reference', 'scan', 'scan_clip']
+
+BYTE, WORD, FLOAT = 0, 1, 2
+
+_TYPES = {
+    ('u', 1): BYTE,
+    ('u', 2): WORD,
+    ('f', 4): FLOAT,
+}
+
+_FORMATS = {
+    'B': BYTE,
+    'H': WORD,
+    'f': FLOAT,
+}
+
+
+def _load_library():
+    candidates = []
+    if os.environ.get('EDGEFIXER_LIBRARY'):
+        candidates.append(os.environ['EDGEFIXER_LIBRARY'])
+    here = os.path.dirname(os.path.abspath(__file__))
+    for name in ('EdgeFixer.dll', 'libedgefixer.so', 'libedgefixer.dylib'):
+        candidates.append(os.path.join(here, name))
+    found = ctypes.util.find_library('edgefixer') or ctypes.util.find_library('EdgeFixer')
+    if found:
+        candidates.append(found)
+
+    for path in candidates:
+        if path and (os.path.exists(path) or path == found):
+            return ctypes.CDLL(path)
+    raise OSError('EdgeFixer library not found; set EDGEFIXER_LIBRARY')
+
+
+_lib = _load_library()
+
+_lib.edgefixer_required_buffer.restype = ctypes.c_size_t
+_lib.edgefixer_required_buffer.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+# The sampled variants take the sampling step where the others take radius.
+for _func in (_lib.edgefixer_continuity, _lib.edgefixer_continuity_sampled):
+    _func.restype = None
+    _func.argtypes = [
+        ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+        ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+for _func in (_lib.edgefixer_reference, _lib.edgefixer_reference_sampled):
+    _func.restype = None
+    _func.argtypes = [
+        ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+        ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+_lib.edgefixer_continuity_interleaved.restype = None
+_lib.edgefixer_continuity_interleaved.argtypes = [
+    ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+    ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+_lib.edgefixer_reference_interleaved.restype = None
+_lib.edgefixer_reference_interleaved.argtypes = [
+    ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+    ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p]
+
+
+class EdgeStats(ctypes.Structure):
+    _fields_ = [
+        ('slope', ctypes.c_double),
+        ('offset', ctypes.c_double),
+        ('residual', ctypes.c_double),
+        ('correction', ctypes.c_double),
+        ('max_change', ctypes.c_double),
+        ('mean_shift', ctypes.c_double),
+        ('gain', ctypes.c_double),
+    ]
+
+
+_measure_edge = {}
+for _type, _name in ((BYTE, 'edgefixer_measure_edge_b'), (WORD, 'edgefixer_measure_edge_w'), (FLOAT, 'edgefixer_measure_edge_f')):
+    _func = getattr(_lib, _name)
+    _func.restype = None
+    _func.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                      ctypes.c_void_p, ctypes.POINTER(EdgeStats)]
+    _measure_edge[_type] = _func
+
+_FULL_SCALE = {BYTE: 255.0, WORD: 65535.0, FLOAT: 1.0}
+
+
+class _PyBuffer(ctypes.Structure):
+    """Py_buffer, through which read-only buffers are addressed."""
+    _fields_ = [
+        ('buf', ctypes.c_void_p),
+        ('obj', ctypes.c_void_p),
+        ('len', ctypes.c_ssize_t),
+        ('itemsize', ctypes.c_ssize_t),
+        ('readonly', ctypes.c_int),
+        ('ndim', ctypes.c_int),
+        ('format', ctypes.c_char_p),
+        ('shape', ctypes.c_void_p),
+        ('strides', ctypes.c_void_p),
+        ('suboffsets', ctypes.c_void_p),
+        ('internal', ctypes.c_void_p),
+    ]
+
+_PyBUF_RECORDS_RO = 0x1c
+
+try:
+    _get_buffer = ctypes.pythonapi.PyObject_GetBuffer
+    _get_buffer.restype = ctypes.c_int
+    _get_buffer.argtypes = [ctypes.py_object, ctypes.POINTER(_PyBuffer), ctypes.c_int]
+    _release_buffer = ctypes.pythonapi.PyBuffer_Release
+    _release_buffer.restype = None
+    _release_buffer.argtypes = [ctypes.POINTER(_PyBuffer)]
+except AttributeError:
+    _get_buffer = None
+
+
+class _Planes(object):
+    """Pointer, strides and shape of a 2-D or 3-D sample buffer, without copying."""
+
+    def __init__(self, obj, writable):
+        self.obj = obj
+        iface = getattr(obj, '__array_interface__', None)
+        if iface is not None:
+            typestr = iface['typestr']
+            if typestr[0] not in '<|=':
+                raise ValueError('samples must be native-endian')
+            self.type = _TYPES.get((typestr[1], int(typestr[2:])))
+            itemsize = int(typestr[2:])
+            self.shape = tuple(iface['shape'])
+            self.strides = tuple(iface.get('strides') or _contiguous_strides(self.shape, itemsize))
+            self.address, readonly = iface['data']
+            if writable and readonly:
+                raise ValueError('array must be writable')
+        else:
+            view = memoryview(obj)
+            self.type = _FORMATS.get(view.format.lstrip('@=<'))
+            itemsize = view.itemsize
+            self.shape = view.shape
+            self.strides = view.strides
+            if view.readonly:
+                if writable:
+                    raise ValueError('buffer must be writable')
+                # ctypes only addresses writable buffers, so read-only ones,
+                # such as the planes of VapourSynth frames, are exported
+                # through the C API. They are copied only where it is missing.
+                if _get_buffer is not None:
+                    buffer = _PyBuffer()
+                    _get_buffer(view, ctypes.byref(buffer), _PyBUF_RECORDS_RO)
+                    self.buffer = buffer
+                    self.address = buffer.buf
+                else:
+                    self.copy = ctypes.create_string_buffer(view.tobytes(), view.nbytes)
+                    self.address = ctypes.addressof(self.copy)
+                    self.strides = _contiguous_strides(self.shape, itemsize)
+            else:
+                self.address = ctypes.addressof(ctypes.c_char.from_buffer(view))
+            self.view = view
+
+        if self.type is None:
+            raise TypeError('samples must be uint8, uint16 or float32')
+        if len(self.shape) not in (2, 3):
+            raise ValueError('expected a 2-D plane or a 3-D batch of planes')
+        if self.strides[-1] != itemsize or self.strides[-2] % itemsize:
+            raise ValueError('samples within a row must be contiguous')
+
+    def __del__(self):
+        buffer = getattr(self, 'buffer', None)
+        if buffer is not None:
+            self.buffer = None
+            _release_buffer(ctypes.byref(buffer))
+
+    @property
+    def count(self):
+        return self.shape[0] if len(self.shape) == 3 else 1
+
+    @property
+    def height(self):
+        return self.shape[-2]
+
+    @property
+    def width(self):
+        return self.shape[-1]
+
+    @property
+    def stride(self):
+        return self.strides[-2]
+
+    def plane(self, i):
+        return self.address + (self.strides[0] * i if len(self.shape) == 3 else 0)
+
+
+def _contiguous_strides(shape, itemsize):
+    strides = []
+    acc = itemsize
+    for dim in reversed(shape):
+        strides.insert(0, acc)
+        acc *= dim
+    return tuple(strides)
+
+
+def _check_edges(planes, left, top, right, bottom, radius, width=None):
+    width = planes.width if width is None else width
+    if min(left, top, right, bottom, radius) < 0:
+        raise ValueError('too few edges to fix')
+    if left > width or right > width or top > planes.height or bottom > planes.height:
+        raise ValueError('too many edges to fix')
+
+
+def _interleaved_width(planes, components, sample):
+    if components < 1 or planes.width % components:
+        raise ValueError('plane width must be a multiple of components')
+    if components > 1 and sample > 1:
+        raise ValueError('sample is not supported with interleaved components')
+    return planes.width // components
+
+
+def _check_sample(sample, radius):
+    if sample < 1:
+        raise ValueError('sample must be at least 1')
+    if sample > 1 and radius:
+        raise ValueError('sample requires radius 0')
+
+
+def _run(planes, threads, func):
+    count = planes.count
+    size = _lib.edgefixer_required_buffer(planes.type, planes.width, planes.height)
+
+    def work(indices):
+        tmp = ctypes.create_string_buffer(size)
+        for i in indices:
+            func(i, tmp)
+
+    if threads is None:
+        threads = os.cpu_count() or 1
+    threads = max(1, min(threads, count))
+    if threads == 1:
+        work(range(count))
+        return
+    with ThreadPoolExecutor(max_workers=threads) as pool:
+        for f in [pool.submit(work, range(t, count, threads)) for t in range(threads)]:
+            f.result()
+
+
+def continuity(frames, left=0, top=0, right=0, bottom=0, radius=0, threads=None, sample=1, components=1):
+    """Fix border lines against the adjacent line, in place. Returns frames.
+
+    sample > 1 fits each line from every sample-th sample (radius 0 only).
+    components > 1 treats each row as that many interleaved components, such
+    as the UV plane of NV12 or P010; edges then count pixels, not samples."""
+    planes = _Planes(frames, True)
+    width = _interleaved_width(planes, components, sample)
+    _check_edges(planes, left, top, right, bottom, radius, width)
+    _check_sample(sample, radius)
+    fix = _lib.edgefixer_continuity_sampled if sample > 1 else _lib.edgefixer_continuity
+    param = sample if sample > 1 else radius
+
+    def func(i, tmp):
+        if components > 1:
+            _lib.edgefixer_continuity_interleaved(planes.type, planes.plane(i), planes.stride, components, width,
+                                                  planes.height, left, top, right, bottom, radius, tmp)
+        else:
+            fix(planes.type, planes.plane(i), planes.stride, planes.width, planes.height,
+                left, top, right, bottom, param, tmp)
+
+    _run(planes, threads, func)
+    return frames
+
+
+def reference(frames, ref, left=0, top=0, right=0, bottom=0, radius=0, threads=None, sample=1, components=1):
+    """Fix border lines against the same lines of a reference, in place. Returns frames.
+
+    sample and components are as for continuity()."""
+    planes = _Planes(frames, True)
+    refs = _Planes(ref, False)
+    width = _interleaved_width(planes, components, sample)
+    _check_edges(planes, left, top, right, bottom, radius, width)
+    _check_sample(sample, radius)
+    fix = _lib.edgefixer_reference_sampled if sample > 1 else _lib.edgefixer_reference
+    param = sample if sample > 1 else radius
+    if refs.type != planes.type or refs.shape[-2:] != planes.shape[-2:]:
+        raise ValueError('clip and reference must have same format')
+    if refs.count != planes.count and refs.count != 1:
+        raise ValueError('reference must be a single plane or match the batch size')
+
+    def func(i, tmp):
+        ref_ptr = refs.plane(i if refs.count > 1 else 0)
+        if components > 1:
+            _lib.edgefixer_reference_interleaved(planes.type, planes.plane(i), planes.stride, ref_ptr, refs.stride,
+                                                 components, width, planes.height, left, top, right, bottom, radius, tmp)
+        else:
+            fix(planes.type, planes.plane(i), planes.stride, ref_ptr, refs.stride,
+                planes.width, planes.height, left, top, right, bottom, param, tmp)
+
+    _run(planes, threads, func)
+    return frames
+
+
+EDGES = ('left', 'top', 'right', 'bottom')
+
+
+def _edge_line(planes, edge, depth):
+    """Address, sample distance and length of line `depth` from `edge`, and of its inner neighbor."""
+    itemsize = planes.strides[-1]
+    base = planes.plane(0)
+    if edge == 'top':
+        return base + planes.stride * depth, base + planes.stride * (depth + 1), itemsize, planes.width
+    if edge == 'bottom':
+        last = planes.height - 1
+        return base + planes.stride * (last - depth), base + planes.stride * (last - depth - 1), itemsize, planes.width
+    if edge == 'left':
+        return base + itemsize * depth, base + itemsize * (depth + 1), planes.stride, planes.height
+    last = planes.width - 1
+    return base + itemsize * (last - depth), base + itemsize * (last - depth - 1), planes.stride, planes.height
+
+
+def _measure_frame(frame, depth, radii, threshold, gain_threshold):
+    """Per plane, per edge, per line: damage score and per-radius residuals."""
+    if isinstance(frame, (list, tuple)):
+        frame = list(frame)
+    else:
+        frame = [frame]
+
+    result = []
+    for plane in frame:
+        planes = _Planes(plane, False)
+        if len(planes.shape) != 2:
+            raise ValueError('scan expects 2-D planes')
+        measure = _measure_edge[planes.type]
+        scale = _FULL_SCALE[planes.type]
+        tmp = ctypes.create_string_buffer(_lib.edgefixer_required_buffer(planes.type, planes.width, planes.height))
+        stats = EdgeStats()
+
+        edges = {}
+        for edge in EDGES:
+            size = planes.height if edge in ('top', 'bottom') else planes.width
+            lines = []
+            for k in range(min(depth, size - 1)):
+                x, y, dist, n = _edge_line(planes, edge, k)
+                residuals = []
+                score = 0.0
+                for radius in radii:
+                    measure(x, y, dist, dist, n, radius, tmp, ctypes.byref(stats))
+                    if radius == 0:
+                        score = max(abs(stats.mean_shift) / scale / threshold, abs(stats.gain - 1.0) / gain_threshold)
+                    residuals.append(stats.residual ** 0.5 / scale)
+                lines.append((score, residuals))
+            edges[edge] = lines
+        result.append(edges)
+    return result
+
+
+def _median(values):
+    values = sorted(values)
+    mid = len(values) // 2
+    return values[mid] if len(values) % 2 else 0.5 * (values[mid - 1] + values[mid])
+
+
+def _recommend(measurements, radii, tolerance):
+    """Combine the measurements of one scene into edge counts and a radius."""
+    rec = {}
+    chosen_radius = 0
+    for p in range(len(measurements[0])):
+        for edge in EDGES:
+            count = 0
+            depth = min(len(m[p][edge]) for m in measurements)
+            for k in range(depth):
+                if _median([m[p][edge][k][0] for m in measurements]) > 1.0:
+                    count = k + 1
+            key = edge if p == 0 else 'c' + edge
+            rec[key] = max(rec.get(key, 0), count)
+
+            for k in range(count):
+                residuals = [_median([m[p][edge][k][1][r] for m in measurements]) for r in range(len(radii))]
+                best = min(residuals)
+                # Prefer the widest window that stays within tolerance of the best fit.
+                for r in sorted(range(len(radii)), key=lambda r: radii[r] or float('inf'), reverse=True):
+                    if residuals[r] <= best * tolerance + 1e-12:
+                        if radii[r] and (not chosen_radius or radii[r] < chosen_radius):
+                            chosen_radius = radii[r]
+                        break
+    rec['radius'] = chosen_radius
+    return rec
+
+
+def _scan(count, sampled, work, radii, tolerance, threads):
+    """Run work(n) over the sampled frames in parallel and recommend
+    parameters per scene. work returns a measurement, or None if frame n is
+    not measured, and whether n starts a scene; frame 0 always does."""
+    if threads is None:
+        threads = os.cpu_count() or 1
+    with ThreadPoolExecutor(max_workers=max(1, threads)) as pool:
+        results = dict(zip(sampled, pool.map(work, sampled)))
+
+    starts = [n for n in sampled if n == 0 or results[n][1]]
+    ends = starts[1:] + [count]
+    result = []
+    for first, end in zip(starts, ends):
+        measurements = [results[n][0] for n in sampled[bisect_left(sampled, first):bisect_left(sampled, end)]
+                        if results[n][0] is not None]
+        rec = _recommend(measurements, radii, tolerance)
+        rec['first'] = first
+        rec['last'] = end - 1
+        result.append(rec)
+    return result
+
+
+def scan(frames, scenes=None, depth=8, threshold=0.01, gain_threshold=0.08, radii=(0, 128, 32, 8), tolerance=1.1, step=1, threads=None):
+    """Recommend edge counts and a radius for each scene of a clip.
+
+    frames is a sequence of frames, each a 2-D plane or a sequence of planes
+    (luma first; further planes yield the chroma counts cleft/ctop/...). Each
+    of the outermost `depth` lines of every edge is fitted against its inner
+    neighbor. A line counts as damaged when, in the median frame of the scene,
+    its mean differs from the neighbor's by more than `threshold` of full
+    scale or its contrast by more than a factor of 1 +/- `gain_threshold`.
+    The radius is the widest of `radii` (0 being the whole line) whose fit
+    residual stays within `tolerance` of the best. `scenes` lists the first frame of each scene; every `step`th frame
+    is measured. Returns a list of dicts, one per scene, with `first` and
+    `last` frame numbers and the recommended parameters.
+    """
+    count = len(frames)
+    if not count:
+        return []
+    if 0 not in radii:
+        radii = (0,) + tuple(radii)
+    starts = sorted(set([0] + [s for s in (scenes or []) if 0 < s < count]))
+    ends = starts[1:] + [count]
+
+    def work(n):
+        return _measure_frame(frames[n], depth, radii, threshold, gain_threshold), n in start_set
+
+    start_set = set(starts)
+    sampled = []
+    for first, end in zip(starts, ends):
+        sampled.extend(range(first, end, max(1, step)))
+    return _scan(count, sampled, work, radii, tolerance, threads)
+
+
+def _frame_planes(frame, planes):
+    if hasattr(frame, 'get_read_array'):
+        return [frame.get_read_array(p) for p in planes]
+    return [frame[p] for p in planes]
+
+
+class _ClipFrames(object):
+    """Lazy sequence of a VapourSynth clip's frames as lists of planes."""
+
+    def __init__(self, clip, planes):
+        self.clip = clip
+        self.planes = planes
+
+    def __len__(self):
+        return self.clip.num_frames
+
+    def __getitem__(self, n):
+        return _frame_planes(self.clip.get_frame(n), self.planes)
+
+
+def scan_clip(clip, planes=(0,), scene_prop='_SceneChangePrev', depth=8, threshold=0.01, gain_threshold=0.08, radii=(0, 128, 32, 8), tolerance=1.1, step=1, threads=None, scenes=None):
+    """scan() a VapourSynth clip. Scenes start at frames whose scene_prop is set.
+
+    Only the border lines of the measured frames are read, without copying
+    the planes. Finding scenes through scene_prop costs a full render of
+    every frame, whatever `step` is: each is fetched once, in the worker
+    threads, for its properties, and measured only if it is every `step`th
+    frame or the first frame of a scene. Given `scenes`, or with scene_prop
+    None, only the measured frames are fetched.
+    """
+    if scenes is not None or not scene_prop:
+        return scan(_ClipFrames(clip, planes), scenes, depth, threshold, gain_threshold, radii, tolerance, step, threads)
+    count = clip.num_frames
+    if not count:
+        return []
+    if 0 not in radii:
+        radii = (0,) + tuple(radii)
+
+    def work(n):
+        frame = clip.get_frame(n)
+        starts_scene = bool(frame.props.get(scene_prop, 0))
+        if n % max(1, step) and not starts_scene:
+            return None, starts_scene
+        return _measure_frame(_frame_planes(frame, planes), depth, radii, threshold, gain_threshold), starts_scene
+
+    return _scan(count, list(range(count)), work, radii, tolerance, threads)